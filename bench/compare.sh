@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+
+# compare two results files written by bench/run.sh, say before and after a change,
+# printing each scenario and engine found in both with the change in seconds and peak memory
+# a change in seconds beyond the threshold is marked, slower with ! and faster with *
+#
+# usage: bench/compare.sh before.tsv after.tsv [threshold percent, default 5]
+
+set -eu
+
+[ $# -ge 2 ] || { echo "usage: bench/compare.sh before.tsv after.tsv [threshold]"; exit 1; }
+
+awk -F '\t' -v limit="${3:-5}" '
+    BEGIN { printf "%-28s %-8s %11s %11s %8s   %8s %8s\n", "scenario", "engine", "before", "after", "change", "rss", "rss" }
+    FNR == 1 { next }
+    NR == FNR { seconds[$2 "\t" $3] = $6; rss[$2 "\t" $3] = $9; next }
+    ($2 "\t" $3) in seconds {
+        key = $2 "\t" $3
+        change = (seconds[key] > 0) ? ($6 - seconds[key]) * 100 / seconds[key] : 0
+        mark = change > limit ? "!" : change < -limit ? "*" : " "
+        printf "%-28s %-8s %10.4fs %10.4fs %+7.1f%% %s %8d %8d kB\n", $2, $3, seconds[key], $6, change, mark, rss[key], $9
+    }
+' "$1" "$2"
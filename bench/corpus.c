@@ -0,0 +1,323 @@
+/* deterministic corpus generator for bench/run.sh
+ *
+ * the same arguments always give the same bytes, so results can be compared between commits
+ *
+ *  sql     lines of varying length looking like sql inserts
+ *  binary  pseudo random bytes
+ *  sparse  a file of holes with a short line of text every 64MB, costing no disk
+ *  script  a dodo program of scattered moves, line motions, expects and writes
+ *          within the first megabyte of an sql corpus, for timing slurp and parse
+ *
+ * every corpus but script ends in the line END_MARK, for searches to find
+ *
+ * given a patch file and count, sql also writes a program patching that many lines
+ * picked at random over the whole file, in scrambled order, each with b, e and w.
+ * the writes put back the bytes already there so the program can be run again
+ *
+ * usage: bench/corpus sql|binary|sparse|script megabytes file [patchfile count]
+ */
+#include <stdio.h> /* printf, fopen, fwrite */
+#include <stdlib.h> /* malloc, atol */
+#include <string.h> /* strcmp, strlen, memmove */
+#include <fcntl.h> /* open */
+#include <unistd.h> /* ftruncate, pwrite, close */
+
+#define END_MARK "-- dodo bench end\n"
+#define OUT_BLOCK (1 << 20)
+/* longer than any sql line */
+#define SQL_LINE_MAX 300
+#define SPARSE_STRIDE (64LL << 20)
+/* offsets within the sql corpus that script programs move between */
+#define SCRIPT_SPAN (1 << 20)
+
+/* 64 bit lcg, taking the high bits as they are the most random */
+static unsigned long long next(unsigned long long *seed){
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 33;
+}
+
+/* add sql lines to buf from byte i until one ends at or past limit,
+ * where buf holds the corpus from byte at
+ * recording the starts of lines into the reservoir of patch offsets
+ * returns the number of bytes of buf used, ending on a line break
+ */
+static size_t fill_sql(char *buf, size_t i, size_t limit, unsigned long long at, unsigned long long *seed,
+                       unsigned long long *lines, unsigned long long *picks, long int npicks, unsigned long long *pick_seed){
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+    unsigned long long id = 0;
+    unsigned long long k = 0;
+    int n = 0;
+    int m = 0;
+
+    while( i < limit ){
+        id = next(seed);
+        if( npicks ){
+            /* reservoir sampling, every line is equally likely to be picked */
+            if( *lines < (unsigned long long)npicks ){
+                picks[*lines] = at + i;
+            } else {
+                k = (next(pick_seed) << 31 | next(pick_seed)) % (*lines + 1);
+                if( k < (unsigned long long)npicks ){
+                    picks[k] = at + i;
+                }
+            }
+        }
+        ++*lines;
+
+        n = sprintf(buf + i, "INSERT INTO `t%llu` VALUES (%llu,'", id % 7, id);
+        i += n;
+        /* payload of 20 to 200 bytes */
+        for( m = 20 + next(seed) % 180; m > 0; --m ){
+            buf[i++] = alphabet[next(seed) % (sizeof(alphabet) - 1)];
+        }
+        memcpy(buf + i, "');\n", 4);
+        i += 4;
+    }
+
+    return i;
+}
+
+/* pad the end of the corpus out with one line of spaces so it is exactly size bytes */
+static size_t pad(char *buf, size_t len){
+    if( len ){
+        memset(buf, ' ', len);
+        buf[len - 1] = '\n';
+    }
+    return len;
+}
+
+static int write_sql(FILE *out, unsigned long long size, const char *patchfile, long int npicks){
+    unsigned long long seed = 42;
+    unsigned long long pick_seed = 7;
+    unsigned long long lines = 0;
+    unsigned long long done = 0;
+    unsigned long long *picks = 0;
+    unsigned long long tmp = 0;
+    unsigned long long j = 0;
+    long int count = 0;
+    long int i = 0;
+    size_t want = 0;
+    size_t keep = 0;
+    size_t n = 0;
+    char *buf = 0;
+    FILE *patch = 0;
+    int ret = 1;
+
+    buf = malloc(OUT_BLOCK + 2 * SQL_LINE_MAX);
+    if( ! buf ){
+        puts("bench/corpus: failed to allocate buffer");
+        goto EXIT;
+    }
+    if( npicks ){
+        picks = malloc(npicks * sizeof(*picks));
+        if( ! picks ){
+            puts("bench/corpus: failed to allocate patch offsets");
+            goto EXIT;
+        }
+    }
+
+    size -= strlen(END_MARK);
+    /* the line running past each block is kept for the start of the next,
+     * so only the end of the corpus is padded
+     */
+    while( size - done > OUT_BLOCK + SQL_LINE_MAX ){
+        n = fill_sql(buf, keep, OUT_BLOCK, done, &seed, &lines, picks, npicks, &pick_seed);
+        if( OUT_BLOCK != fwrite(buf, 1, OUT_BLOCK, out) ){
+            puts("bench/corpus: failed to write corpus");
+            goto EXIT;
+        }
+        keep = n - OUT_BLOCK;
+        memmove(buf, buf + OUT_BLOCK, keep);
+        done += OUT_BLOCK;
+    }
+    want = size - done;
+    n = fill_sql(buf, keep, want > SQL_LINE_MAX ? want - SQL_LINE_MAX : 0, done, &seed, &lines, picks, npicks, &pick_seed);
+    n += pad(buf + n, want - n);
+    if( n != fwrite(buf, 1, n, out) ){
+        puts("bench/corpus: failed to write corpus");
+        goto EXIT;
+    }
+    if( 1 != fwrite(END_MARK, strlen(END_MARK), 1, out) ){
+        puts("bench/corpus: failed to write corpus");
+        goto EXIT;
+    }
+
+    if( ! npicks ){
+        ret = 0;
+        goto EXIT;
+    }
+
+    /* a small corpus may have fewer lines than patches asked for */
+    count = lines < (unsigned long long)npicks ? (long int)lines : npicks;
+
+    /* scramble the order the lines are patched in */
+    for( i = count - 1; i > 0; --i ){
+        j = next(&pick_seed) % (i + 1);
+        tmp = picks[i];
+        picks[i] = picks[j];
+        picks[j] = tmp;
+    }
+
+    patch = fopen(patchfile, "w");
+    if( ! patch ){
+        perror("bench/corpus: failed to open patch file");
+        goto EXIT;
+    }
+    for( i = 0; i < count; ++i ){
+        fprintf(patch, "b%llu\ne/INSERT INTO `t/\nw/INSERT/\n", picks[i]);
+    }
+    if( fclose(patch) ){
+        perror("bench/corpus: failed to write patch file");
+        goto EXIT;
+    }
+
+    ret = 0;
+
+EXIT:
+    free(picks);
+    free(buf);
+    return ret;
+}
+
+static int write_binary(FILE *out, unsigned long long size){
+    unsigned long long seed = 42;
+    unsigned long long done = 0;
+    size_t want = 0;
+    size_t i = 0;
+    char *buf = 0;
+
+    buf = malloc(OUT_BLOCK);
+    if( ! buf ){
+        puts("bench/corpus: failed to allocate buffer");
+        return 1;
+    }
+
+    size -= strlen(END_MARK);
+    while( done < size ){
+        want = size - done < OUT_BLOCK ? size - done : OUT_BLOCK;
+        for( i = 0; i < want; ++i ){
+            buf[i] = next(&seed) >> 8;
+        }
+        if( want != fwrite(buf, 1, want, out) ){
+            puts("bench/corpus: failed to write corpus");
+            free(buf);
+            return 1;
+        }
+        done += want;
+    }
+    free(buf);
+
+    if( 1 != fwrite(END_MARK, strlen(END_MARK), 1, out) ){
+        puts("bench/corpus: failed to write corpus");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int write_sparse(int fd, unsigned long long size){
+    char line[64];
+    unsigned long long at = 0;
+    int n = 0;
+
+    if( ftruncate(fd, size) ){
+        perror("bench/corpus: failed to size sparse file");
+        return 1;
+    }
+
+    for( at = 0; at + SPARSE_STRIDE < size; at += SPARSE_STRIDE ){
+        n = sprintf(line, "-- dodo bench block %llu\n", at / SPARSE_STRIDE);
+        if( n != pwrite(fd, line, n, at) ){
+            perror("bench/corpus: failed to write sparse file");
+            return 1;
+        }
+    }
+
+    n = strlen(END_MARK);
+    if( n != pwrite(fd, END_MARK, n, size - n) ){
+        perror("bench/corpus: failed to write sparse file");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int write_script(FILE *out, unsigned long long size){
+    unsigned long long seed = 42;
+    unsigned long long done = 0;
+    int n = 0;
+
+    while( done < size ){
+        n = fprintf(out, "b%llu\nl+1\ne/INSERT INTO `t/\nw/INSERT/ # put back\n", next(&seed) % SCRIPT_SPAN);
+        if( n < 0 ){
+            puts("bench/corpus: failed to write script");
+            return 1;
+        }
+        done += n;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv){
+    unsigned long long size = 0;
+    long int npicks = 0;
+    FILE *out = 0;
+    int fd = -1;
+    int ret = 1;
+
+    if( argc != 4 && argc != 6 ){
+        puts("usage: bench/corpus sql|binary|sparse|script megabytes file [patchfile count]");
+        return EXIT_FAILURE;
+    }
+
+    size = (unsigned long long)atol(argv[2]) << 20;
+    if( size < strlen(END_MARK) ){
+        puts("bench/corpus: size must be at least 1 megabyte");
+        return EXIT_FAILURE;
+    }
+    if( argc == 6 ){
+        npicks = atol(argv[5]);
+        if( npicks < 0 || strcmp(argv[1], "sql") ){
+            puts("bench/corpus: only sql writes a patch file");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if( ! strcmp(argv[1], "sparse") ){
+        fd = open(argv[3], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if( fd == -1 ){
+            perror("bench/corpus: failed to open file");
+            return EXIT_FAILURE;
+        }
+        ret = write_sparse(fd, size);
+        if( close(fd) ){
+            perror("bench/corpus: failed to close file");
+            ret = 1;
+        }
+        return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    out = fopen(argv[3], "w");
+    if( ! out ){
+        perror("bench/corpus: failed to open file");
+        return EXIT_FAILURE;
+    }
+
+    if( ! strcmp(argv[1], "sql") ){
+        ret = write_sql(out, size, argc == 6 ? argv[4] : 0, npicks);
+    } else if( ! strcmp(argv[1], "binary") ){
+        ret = write_binary(out, size);
+    } else if( ! strcmp(argv[1], "script") ){
+        ret = write_script(out, size);
+    } else {
+        printf("bench/corpus: unknown corpus '%s'\n", argv[1]);
+    }
+
+    if( fclose(out) ){
+        perror("bench/corpus: failed to write file");
+        ret = 1;
+    }
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+/* run a command and measure it for bench/run.sh
+ *
+ * the command inherits stdin and stdout, so they can be redirected around it,
+ * and once it exits a line of wall clock seconds and peak resident set size
+ * in kilobytes is written to resultfile
+ *
+ * exits as the command did
+ *
+ * usage: bench/measure resultfile command [args...]
+ */
+#include <stdio.h> /* fprintf, perror */
+#include <stdlib.h> /* exit */
+#include <time.h> /* clock_gettime */
+#include <unistd.h> /* fork, execvp */
+#include <sys/resource.h> /* getrusage */
+#include <sys/wait.h> /* waitpid */
+
+/* seconds on monotonic clock */
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+    struct rusage usage;
+    FILE *result = 0;
+    double start = 0;
+    double elapsed = 0;
+    pid_t pid = 0;
+    int status = 0;
+
+    if( argc < 3 ){
+        puts("usage: bench/measure resultfile command [args...]");
+        return EXIT_FAILURE;
+    }
+
+    start = now();
+    pid = fork();
+    if( pid == -1 ){
+        perror("bench/measure: failed to fork");
+        return EXIT_FAILURE;
+    }
+    if( ! pid ){
+        execvp(argv[2], argv + 2);
+        perror("bench/measure: failed to run command");
+        _exit(127);
+    }
+
+    if( waitpid(pid, &status, 0) == -1 ){
+        perror("bench/measure: failed to wait for command");
+        return EXIT_FAILURE;
+    }
+    elapsed = now() - start;
+
+    /* the command is the only child waited for, so its peak is the children's */
+    if( getrusage(RUSAGE_CHILDREN, &usage) ){
+        perror("bench/measure: failed to get resource usage");
+        return EXIT_FAILURE;
+    }
+
+    result = fopen(argv[1], "w");
+    if( ! result ){
+        perror("bench/measure: failed to open result file");
+        return EXIT_FAILURE;
+    }
+    /* ru_maxrss is in kilobytes on linux */
+    fprintf(result, "%.6f %ld\n", elapsed, usage.ru_maxrss);
+    if( fclose(result) ){
+        perror("bench/measure: failed to write result file");
+        return EXIT_FAILURE;
+    }
+
+    if( WIFSIGNALED(status) ){
+        fprintf(stderr, "bench/measure: '%s' killed by signal %d\n", argv[2], WTERMSIG(status));
+        return EXIT_FAILURE;
+    }
+
+    return WEXITSTATUS(status);
+}
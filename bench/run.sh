@@ -0,0 +1,151 @@
+#!/usr/bin/env bash
+
+# run dodo over a synthetic corpus made by bench/corpus and measure each scenario
+# through each engine, printing one tab separated line per run:
+#
+#   commit    the commit of the tree, with + when it has changes
+#   scenario  what was run, see below
+#   engine    the engine option given
+#   bytes     bytes of corpus, or of program for script, the run covers
+#   commands  commands in the program
+#   seconds   best wall clock time of the rounds
+#   mb_s      bytes / seconds in megabytes
+#   us_cmd    seconds / commands in microseconds
+#   rss_kb    largest peak resident set size of the rounds
+#   syscalls  system calls made, counted in a separate run with strace -c,
+#             or - without strace
+#
+# the corpus is kept in BENCH_DIR and only made again when missing,
+# as it is the same bytes every time. rounds run one after another so all but
+# the first find the corpus in the page cache where it fits
+#
+# compare two runs with bench/compare.sh
+#
+# usage: bench/run.sh [dodo] > results.tsv
+#
+#   BENCH_DIR        where the corpus is kept, default /var/tmp/dodo-bench
+#   BENCH_MB         size of the sql and binary corpus, default 256
+#   BENCH_SPARSE_MB  size of the sparse corpus, default 4096
+#   BENCH_SCRIPT_MB  size of the program for script, default 16
+#   BENCH_PATCHES    lines patched by patch, default 100000
+#   BENCH_ROUNDS     runs of each scenario, default 3
+#   BENCH_ENGINES    engines to run through, default "--pread --mmap --uring"
+
+set -eu
+
+DODO=${1:-./bench/dodo}
+BENCH_DIR=${BENCH_DIR:-/var/tmp/dodo-bench}
+BENCH_MB=${BENCH_MB:-256}
+BENCH_SPARSE_MB=${BENCH_SPARSE_MB:-4096}
+BENCH_SCRIPT_MB=${BENCH_SCRIPT_MB:-16}
+BENCH_PATCHES=${BENCH_PATCHES:-100000}
+BENCH_ROUNDS=${BENCH_ROUNDS:-3}
+BENCH_ENGINES=${BENCH_ENGINES:---pread --mmap --uring}
+
+CORPUS=./bench/corpus
+MEASURE=./bench/measure
+
+for tool in "$DODO" $CORPUS $MEASURE; do
+    [ -x "$tool" ] || { echo "bench/run.sh: '$tool' is missing, run make bench" >&2; exit 1; }
+done
+
+mkdir -p "$BENCH_DIR"
+SQL=$BENCH_DIR/sql-$BENCH_MB
+PATCH=$BENCH_DIR/sql-$BENCH_MB-$BENCH_PATCHES.dodo
+BINARY=$BENCH_DIR/binary-$BENCH_MB
+SPARSE=$BENCH_DIR/sparse-$BENCH_SPARSE_MB
+SCRIPT=$BENCH_DIR/script-$BENCH_SCRIPT_MB.dodo
+WORK=$(mktemp -d) || exit
+
+# make corpus file with bench/corpus arguments, unless an earlier run did
+make_corpus() {
+    local file=$1
+    shift
+    [ -e "$file.done" ] && return
+    echo "bench/run.sh: making '$file'" >&2
+    $CORPUS "$@"
+    touch "$file.done"
+}
+
+make_corpus "$SQL" sql "$BENCH_MB" "$SQL" "$PATCH" "$BENCH_PATCHES"
+make_corpus "$BINARY" binary "$BENCH_MB" "$BINARY"
+make_corpus "$SPARSE" sparse "$BENCH_SPARSE_MB" "$SPARSE"
+# the script moves within the first megabyte of the sql corpus, any size of it will do
+make_corpus "$SCRIPT" script "$BENCH_SCRIPT_MB" "$SCRIPT"
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo -)
+if [ "$COMMIT" != - ] && ! git diff --quiet HEAD -- 2>/dev/null; then
+    COMMIT=$COMMIT+
+fi
+
+# scenario name, corpus, program, options for dodo other than the engine
+run() {
+    local name=$1 file=$2 program=$3 opts=$4 engine
+    local bytes commands best rss seconds peak syscalls round
+
+    if [ "$name" = script ]; then
+        bytes=$(stat -c %s "$program")
+    else
+        bytes=$(stat -c %s "$file")
+    fi
+    commands=$(grep -c . "$program")
+
+    for engine in $BENCH_ENGINES; do
+        best=; rss=0
+        for round in $(seq "$BENCH_ROUNDS"); do
+            $MEASURE "$WORK/result" $DODO $engine $opts "$file" < "$program" > /dev/null ||
+                { echo "bench/run.sh: $name with '$engine $opts' failed" >&2; exit 1; }
+            read -r seconds peak < "$WORK/result"
+            if [ -z "$best" ] || awk "BEGIN { exit !($seconds < $best) }"; then
+                best=$seconds
+            fi
+            [ "$peak" -gt "$rss" ] && rss=$peak
+        done
+
+        syscalls=-
+        if command -v strace > /dev/null; then
+            strace -f -c -o "$WORK/trace" $DODO $engine $opts "$file" < "$program" > /dev/null
+            # summary lines are: % time, seconds, usecs/call, calls, [errors], syscall
+            syscalls=$(awk '$4 ~ /^[0-9]+$/ && $NF != "total" { n += $4 } END { print n + 0 }' "$WORK/trace")
+        fi
+
+        awk -v c="$COMMIT" -v n="$name${opts:+ $opts}" -v e="${engine#--}" -v b="$bytes" -v k="$commands" \
+            -v s="$best" -v r="$rss" -v y="$syscalls" 'BEGIN {
+            printf "%s\t%s\t%s\t%d\t%d\t%.6f\t%.1f\t%.3f\t%d\t%s\n", c, n, e, b, k, s, b / s / 1048576, s * 1e6 / k, r, y
+        }'
+    done
+}
+
+# write program made of the remaining arguments, one command per line
+program() {
+    local file=$WORK/$1
+    shift
+    printf '%s\n' "$@" > "$file"
+    echo "$file"
+}
+
+printf 'commit\tscenario\tengine\tbytes\tcommands\tseconds\tmb_s\tus_cmd\trss_kb\tsyscalls\n'
+
+# eval_line counting every newline in the file on the way to the last line
+LINES=$(wc -l < "$SQL")
+run line "$SQL" "$(program last "l$LINES")" ""
+run line "$SQL" "$(program last "l$LINES")" "-j 4"
+# literal and regular expression searches through to the end
+run search "$SQL" "$(program search '/-- dodo bench end/')" ""
+run regex "$SQL" "$(program regex 'r/dodo b[e]nch end$/')" ""
+# checksumming and printing the whole file
+run hash "$SQL" "$(program hash 'h')" ""
+run hash "$SQL" "$(program hash 'h')" "-j 4"
+run print "$SQL" "$(program print "c$(stat -c %s "$SQL")")" ""
+# scattered b, e and w, so us_cmd is the latency of each
+run patch "$SQL" "$PATCH" ""
+run patch "$SQL" "$PATCH" "-P"
+# slurp and parse of a large program, each command cheap to run
+run script "$SQL" "$SCRIPT" ""
+run binary-search "$BINARY" "$(program search '/-- dodo bench end/')" ""
+run binary-hash "$BINARY" "$(program hash 'h')" ""
+# mostly holes, so the read path rather than the disk
+run sparse-line "$SPARSE" "$(program last "l$(wc -l < "$SPARSE")")" ""
+run sparse-search "$SPARSE" "$(program search '/-- dodo bench end/')" ""
+
+rm -rf -- "$WORK"
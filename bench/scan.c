@@ -0,0 +1,228 @@
+/* micro-benchmark for the newline scanning kernels in scan.c
+ *
+ * times a full newline count over an in-memory buffer of sql-dump-like text
+ * for the byte loop eval_line used to run, then for each kernel this cpu supports
+ *
+ * then times scan_find and scan_find_last looking for needles that never match,
+ * against memchr for a byte that never occurs
+ *
+ * then times scan_hex encoding the buffer a block at a time
+ *
+ * usage: bench/scan [megabytes]
+ */
+#include <stdio.h> /* printf */
+#include <stdlib.h> /* malloc, atol */
+#include <string.h> /* memchr, strlen */
+#include <time.h> /* clock_gettime */
+
+#include "scan.h"
+
+#define DEFAULT_MB 256
+#define ROUNDS 5
+/* bytes hex encoded per call, as eval_hexdump does */
+#define HEX_BLOCK (1 << 20)
+
+/* seconds on monotonic clock */
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the per byte loop from eval_line before scan.c existed */
+static size_t byte_loop(const char *buf, size_t len, long int target){
+    long int observed = 0;
+    size_t i = 0;
+
+    for( i = 0; i < len; i++ ){
+        if( buf[i] == '\n' && ++observed >= target ){
+            break;
+        }
+    }
+
+    return observed;
+}
+
+/* fill buf with lines of varying length looking like sql inserts */
+static void fill(char *buf, size_t len){
+    unsigned long seed = 42;
+    size_t i = 0;
+    int n = 0;
+
+    while( i < len ){
+        n = snprintf(buf + i, len - i, "INSERT INTO `t%lu` VALUES (%lu,'", seed % 7, seed);
+        i += n > 0 ? (size_t)n : 0;
+        /* payload of 20 to 200 bytes */
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        for( n = 20 + (seed >> 33) % 180; n > 0 && i < len; --n ){
+            buf[i++] = 'a' + (seed >> (n % 32)) % 26;
+        }
+        if( i < len ){
+            buf[i++] = '\n';
+        }
+    }
+}
+
+/* hex encode buf a block at a time through out
+ * returns sum of the digits, to check kernels against each other
+ */
+static size_t hex(const char *buf, size_t len, char *out){
+    size_t sum = 0;
+    size_t want = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    for( i = 0; i < len; i += want ){
+        want = len - i < HEX_BLOCK ? len - i : HEX_BLOCK;
+        scan_hex(buf + i, want, out);
+        for( j = 0; j < 2 * want; j += 64 ){
+            sum += (unsigned char)out[j];
+        }
+    }
+
+    return sum;
+}
+
+static void report(const char *name, size_t len, double best, size_t count){
+    printf("%-28s %8.2f GB/s  (%zu found)\n", name, len / best / 1e9, count);
+}
+
+int main(int argc, char **argv){
+    static const char *names[] = { "scalar", "sse2", "avx2", "avx512", 0 };
+    /* none of these occur in the generated text */
+    static const char *needles[] = { "#", "t7`", "INSERT INTO `t9`", "INSERT INTO `customer_orders` VALUES", 0 };
+    struct Needle needle;
+    char label[80];
+    size_t found = 0;
+    size_t len = (size_t)(argc > 1 ? atol(argv[1]) : DEFAULT_MB) << 20;
+    char *buf = 0;
+    char *out = 0;
+    size_t expected = 0;
+    size_t count = 0;
+    size_t want = 0;
+    double start = 0;
+    double elapsed = 0;
+    double best = 0;
+    int round = 0;
+    int n = 0;
+    int k = 0;
+
+    buf = malloc(len);
+    if( ! buf ){
+        puts("bench/scan: failed to allocate buffer");
+        return EXIT_FAILURE;
+    }
+    fill(buf, len);
+
+    printf("scanning %zu MB, best of %d rounds\n", len >> 20, ROUNDS);
+
+    for( round = 0; round < ROUNDS; ++round ){
+        start = now();
+        expected = byte_loop(buf, len, -1UL >> 1);
+        elapsed = now() - start;
+        if( ! round || elapsed < best ){
+            best = elapsed;
+        }
+    }
+    report("byte loop (before)", len, best, expected);
+
+    for( n = 0; names[n]; ++n ){
+        if( scan_select(names[n]) ){
+            printf("%-28s unsupported on this cpu\n", names[n]);
+            continue;
+        }
+
+        for( round = 0; round < ROUNDS; ++round ){
+            start = now();
+            want = (size_t)-1;
+            scan_newlines(buf, len, &want);
+            count = (size_t)-1 - want;
+            elapsed = now() - start;
+            if( ! round || elapsed < best ){
+                best = elapsed;
+            }
+        }
+        report(names[n], len, best, count);
+
+        if( count != expected ){
+            printf("bench/scan: kernel '%s' counted %zu newlines, expected %zu\n", names[n], count, expected);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for( round = 0; round < ROUNDS; ++round ){
+        start = now();
+        found = memchr(buf, '#', len) ? 0 : SCAN_NONE;
+        elapsed = now() - start;
+        if( ! round || elapsed < best ){
+            best = elapsed;
+        }
+    }
+    report("memchr (reference)", len, best, found == SCAN_NONE ? 0 : 1);
+
+    for( k = 0; names[k]; ++k ){
+        if( scan_select(names[k]) ){
+            continue;
+        }
+
+        for( n = 0; needles[n]; ++n ){
+            scan_needle(&needle, needles[n], strlen(needles[n]));
+            for( round = 0; round < ROUNDS; ++round ){
+                start = now();
+                found = scan_find(&needle, buf, len);
+                elapsed = now() - start;
+                if( ! round || elapsed < best ){
+                    best = elapsed;
+                }
+            }
+            snprintf(label, sizeof(label), "%s find '%.20s'", names[k], needles[n]);
+            report(label, len, best, found == SCAN_NONE ? 0 : 1);
+
+            for( round = 0; round < ROUNDS; ++round ){
+                start = now();
+                found = scan_find_last(&needle, buf, len);
+                elapsed = now() - start;
+                if( ! round || elapsed < best ){
+                    best = elapsed;
+                }
+            }
+            snprintf(label, sizeof(label), "%s find_last '%.20s'", names[k], needles[n]);
+            report(label, len, best, found == SCAN_NONE ? 0 : 1);
+        }
+    }
+
+    out = malloc(2 * HEX_BLOCK);
+    if( ! out ){
+        puts("bench/scan: failed to allocate buffer");
+        return EXIT_FAILURE;
+    }
+
+    expected = 0;
+    for( k = 0; names[k]; ++k ){
+        if( scan_select(names[k]) ){
+            continue;
+        }
+
+        for( round = 0; round < ROUNDS; ++round ){
+            start = now();
+            count = hex(buf, len, out);
+            elapsed = now() - start;
+            if( ! round || elapsed < best ){
+                best = elapsed;
+            }
+        }
+        snprintf(label, sizeof(label), "%s hex", names[k]);
+        report(label, len, best, count);
+
+        if( ! k ){
+            expected = count;
+        } else if( count != expected ){
+            printf("bench/scan: kernel '%s' hex encoded differently to scalar\n", names[k]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    free(out);
+    free(buf);
+    return EXIT_SUCCESS;
+}
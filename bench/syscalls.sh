@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+
+# count file access system calls made by each engine
+# while running the t/tests/exhaustive corpus, using strace -c
+#
+# usage: bench/syscalls.sh [dodo]
+
+hash strace || { echo "bench/syscalls.sh: strace is required"; exit 1; }
+
+set -eu
+
+DODO=${1:-./dodo}
+TESTS_DIR=t/tests/exhaustive
+TRACE=read,write,lseek,pread64,pwrite64,truncate,ftruncate,fstat,newfstatat,mmap,munmap,madvise,fadvise64,io_uring_enter
+TMPDIR=$(mktemp -d) || exit
+
+printf '%-8s %8s %8s %8s %8s %8s\n' engine calls lseek read pread enter
+for engine in --stdio --pread --mmap --uring; do
+    total=0; lseek=0; read=0; pread=0; enter=0
+    for infile in $TESTS_DIR/*.in; do
+        base=${infile%.in}
+        cp "$infile" "$TMPDIR/file"
+        strace -c -o "$TMPDIR/trace" -e trace=$TRACE \
+            $DODO $engine "$TMPDIR/file" < "$base.dodo" > /dev/null
+        # summary lines are: % time, seconds, usecs/call, calls, [errors], syscall
+        total=$((total + $(awk '$4 ~ /^[0-9]+$/ && $NF != "total" { n += $4 } END { print n + 0 }' "$TMPDIR/trace")))
+        lseek=$((lseek + $(awk '$NF == "lseek" { n = $4 } END { print n + 0 }' "$TMPDIR/trace")))
+        read=$((read + $(awk '$NF == "read" { n = $4 } END { print n + 0 }' "$TMPDIR/trace")))
+        pread=$((pread + $(awk '$NF == "pread64" { n = $4 } END { print n + 0 }' "$TMPDIR/trace")))
+        enter=$((enter + $(awk '$NF == "io_uring_enter" { n = $4 } END { print n + 0 }' "$TMPDIR/trace")))
+    done
+    printf '%-8s %8d %8d %8d %8d %8d\n' "${engine#--}" $total $lseek $read $pread $enter
+done
+
+rm -rf -- "$TMPDIR"
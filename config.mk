@@ -4,9 +4,9 @@ PREFIX = /usr
 MANPREFIX = ${PREFIX}/share/man
 
 INCS = 
-LIBS = 
+LIBS = -lpthread
 
-CFLAGS = -std=c99 -pedantic -Werror -Wall -Wstrict-prototypes -Wshadow -Wdeclaration-after-statement -Wunused-function -D_XOPEN_SOURCE -D_XOPEN_SOURCE_EXTENDED ${INCS}
+CFLAGS = -std=c99 -pedantic -Werror -Wall -Wstrict-prototypes -Wshadow -Wdeclaration-after-statement -Wunused-function -D_XOPEN_SOURCE=700 -D_XOPEN_SOURCE_EXTENDED -D_FILE_OFFSET_BITS=64 ${INCS}
 # NB: including  -fprofile-arcs -ftest-coverage for gcov
 # travis wasn't happy with -Wmaybe-uninitialized  so removed for now
 # -Wextra was removed due to unused params
@@ -0,0 +1,1114 @@
+#include <stdio.h> /* printf, puts */
+#include <stdlib.h> /* malloc, realloc, free, qsort */
+#include <string.h> /* memset, memcmp, memcpy */
+
+#include "dfa.h"
+#include "scan.h" /* scan_needle, scan_find */
+
+/* upper bound on nfa size, repeats are unrolled so this is what limits them */
+#define MAX_NODES 65536
+/* dfa states cached before the cache is flushed and rebuilt as needed */
+#define MAX_STATES 4096
+#define HASH_SIZE 8192
+
+/* a byte set is a 256 bit bitmap */
+#define SET_BYTES 32
+#define SET_HAS(set, c) ((set)[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & 7)))
+#define SET_ADD(set, c) ((set)[(unsigned char)(c) >> 3] |= (1 << ((unsigned char)(c) & 7)))
+
+
+/***** syntax tree *****/
+
+enum AstType {
+    /* matches one byte in set */
+    AST_SET,
+    /* left then right */
+    AST_CAT,
+    /* left or right */
+    AST_ALT,
+    /* left between min and max times, max of -1 is unbounded */
+    AST_REPEAT,
+    /* start of line */
+    AST_BOL,
+    /* end of line */
+    AST_EOL,
+    /* matches without consuming anything */
+    AST_EMPTY
+};
+
+struct Ast {
+    enum AstType type;
+    unsigned char set[SET_BYTES];
+    struct Ast *left;
+    struct Ast *right;
+    int min;
+    int max;
+};
+
+struct Parser {
+    const char *pat;
+    size_t len;
+    size_t pos;
+    /* every node comes out of pool, freed in one go */
+    struct Ast *pool;
+    size_t used;
+    size_t cap;
+};
+
+
+/***** nfa and dfa *****/
+
+enum NodeType {
+    /* consume one byte in set then go to out */
+    NODE_SET,
+    /* go to both out and out1 */
+    NODE_SPLIT,
+    /* go to out if the byte behind is a newline or there is none */
+    NODE_BEHIND,
+    /* go to out if the byte ahead is a newline or there is none */
+    NODE_AHEAD,
+    NODE_MATCH
+};
+
+struct Node {
+    enum NodeType type;
+    int out;
+    int out1;
+    unsigned char set[SET_BYTES];
+};
+
+/* interesting states have a non-zero flags, so the scan loops test one word */
+/* holds NODE_MATCH */
+#define STATE_MATCH 1
+/* holds NODE_MATCH if the byte ahead is a newline or there is none */
+#define STATE_AHEAD 2
+/* holds nothing, no match can come from here */
+#define STATE_DEAD 4
+/* forward start state which can be skipped ahead with the literal prefix */
+#define STATE_START 8
+
+struct DState {
+    /* transitions built so far, 0 until first taken */
+    struct DState *next[256];
+    struct DState *chain;
+    unsigned int hash;
+    int flags;
+    /* state was entered past a newline, or at the start of input */
+    int behind;
+    /* sorted nfa nodes making up this state */
+    size_t n;
+    int nodes[1];
+};
+
+/* nfa for one direction along with its cache of dfa states */
+struct Prog {
+    struct Node *nodes;
+    size_t n;
+    size_t cap;
+    int start;
+    /* use the literal prefix to skip ahead from the start states */
+    int prefilter;
+
+    /* scratch space for building states, each n nodes long */
+    unsigned int *mark;
+    unsigned int gen;
+    int *stack;
+    int *expand;
+    int *moved;
+    int *closed;
+    int *ahead;
+
+    struct DState *table[HASH_SIZE];
+    size_t states;
+    /* start state for each value of behind */
+    struct DState *starts[2];
+};
+
+struct Dfa {
+    struct Prog fwd;
+    struct Prog back;
+    /* bytes every match starts with, may be empty */
+    char *prefix;
+    struct Needle literal;
+};
+
+
+/***** parsing *****/
+
+static struct Ast * ast_new(struct Parser *p, enum AstType type){
+    struct Ast *a = 0;
+
+    /* pool is sized so this can't happen for a well formed pattern */
+    if( p->used >= p->cap ){
+        puts("dfa_compile: pattern too complex");
+        return 0;
+    }
+
+    a = &(p->pool[p->used++]);
+    memset(a, 0, sizeof(*a));
+    a->type = type;
+    return a;
+}
+
+static struct Ast * ast_pair(struct Parser *p, enum AstType type, struct Ast *left, struct Ast *right){
+    struct Ast *a = ast_new(p, type);
+
+    if( a ){
+        a->left = left;
+        a->right = right;
+    }
+
+    return a;
+}
+
+static void set_range(unsigned char *set, int lo, int hi){
+    int c = 0;
+
+    for( c = lo; c <= hi; ++c ){
+        SET_ADD(set, c);
+    }
+}
+
+static void set_invert(unsigned char *set){
+    int i = 0;
+
+    for( i = 0; i < SET_BYTES; ++i ){
+        set[i] = ~set[i];
+    }
+}
+
+/* adds the byte or class escaped by the '\' at p->pos to set
+ * returns 1 if it was a single byte, which is stored in *c
+ * returns 0 if it was a class
+ * returns -1 on error
+ */
+static int parse_escape(struct Parser *p, unsigned char *set, int *c){
+    unsigned char class[SET_BYTES];
+    int invert = 0;
+    int i = 0;
+
+    /* skip '\' */
+    ++(p->pos);
+    if( p->pos >= p->len ){
+        puts("dfa_compile: trailing '\\' in pattern");
+        return -1;
+    }
+
+    memset(class, 0, sizeof(class));
+    switch( p->pat[p->pos++] ){
+        case 'n':
+            *c = '\n';
+            break;
+        case 't':
+            *c = '\t';
+            break;
+        case 'r':
+            *c = '\r';
+            break;
+
+        case 'D':
+            invert = 1;
+            /* fall through */
+        case 'd':
+            set_range(class, '0', '9');
+            goto CLASS;
+
+        case 'W':
+            invert = 1;
+            /* fall through */
+        case 'w':
+            set_range(class, '0', '9');
+            set_range(class, 'a', 'z');
+            set_range(class, 'A', 'Z');
+            SET_ADD(class, '_');
+            goto CLASS;
+
+        case 'S':
+            invert = 1;
+            /* fall through */
+        case 's':
+            set_range(class, '\t', '\r');
+            SET_ADD(class, ' ');
+            goto CLASS;
+
+        default:
+            /* any other escaped byte stands for itself */
+            *c = (unsigned char)p->pat[p->pos - 1];
+            break;
+    }
+
+    SET_ADD(set, *c);
+    return 1;
+
+CLASS:
+    if( invert ){
+        set_invert(class);
+    }
+    for( i = 0; i < SET_BYTES; ++i ){
+        set[i] |= class[i];
+    }
+    return 0;
+}
+
+/* [abc], [^a-z], p->pos is just past the '[' */
+static int parse_class(struct Parser *p, unsigned char *set){
+    int negate = 0;
+    int first = 1;
+    int lo = 0;
+    int hi = 0;
+    int ret = 0;
+
+    if( p->pos < p->len && p->pat[p->pos] == '^' ){
+        negate = 1;
+        ++(p->pos);
+    }
+
+    /* a ']' straight after the '[' or '[^' is a literal */
+    for( ; p->pos < p->len && (first || p->pat[p->pos] != ']'); first = 0 ){
+        if( p->pat[p->pos] == '\\' ){
+            ret = parse_escape(p, set, &lo);
+            if( ret == -1 ){
+                return 1;
+            }
+            if( ret == 0 ){
+                /* classes can't start a range */
+                continue;
+            }
+        } else {
+            lo = (unsigned char)p->pat[p->pos++];
+        }
+
+        /* a '-' last in the class is a literal */
+        if( p->pos + 1 < p->len && p->pat[p->pos] == '-' && p->pat[p->pos + 1] != ']' ){
+            ++(p->pos);
+            if( p->pat[p->pos] == '\\' ){
+                if( parse_escape(p, set, &hi) != 1 ){
+                    puts("dfa_compile: range in character class must end in a single byte");
+                    return 1;
+                }
+            } else {
+                hi = (unsigned char)p->pat[p->pos++];
+            }
+            if( hi < lo ){
+                printf("dfa_compile: range '%c-%c' in character class is backwards\n", lo, hi);
+                return 1;
+            }
+            set_range(set, lo, hi);
+        } else {
+            SET_ADD(set, lo);
+        }
+    }
+
+    if( p->pos >= p->len ){
+        puts("dfa_compile: unterminated character class, expected ']'");
+        return 1;
+    }
+
+    /* skip ']' */
+    ++(p->pos);
+
+    if( negate ){
+        set_invert(set);
+    }
+
+    return 0;
+}
+
+static struct Ast * parse_alt(struct Parser *p);
+
+static struct Ast * parse_atom(struct Parser *p){
+    struct Ast *a = 0;
+    int c = 0;
+
+    switch( p->pat[p->pos] ){
+        case '(':
+            ++(p->pos);
+            a = parse_alt(p);
+            if( ! a ){
+                return 0;
+            }
+            if( p->pos >= p->len || p->pat[p->pos] != ')' ){
+                puts("dfa_compile: unterminated group, expected ')'");
+                return 0;
+            }
+            ++(p->pos);
+            return a;
+
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            printf("dfa_compile: nothing to repeat before '%c' at offset %zu\n", p->pat[p->pos], p->pos);
+            return 0;
+
+        case '^':
+            ++(p->pos);
+            return ast_new(p, AST_BOL);
+
+        case '$':
+            ++(p->pos);
+            return ast_new(p, AST_EOL);
+
+        default:
+            break;
+    }
+
+    a = ast_new(p, AST_SET);
+    if( ! a ){
+        return 0;
+    }
+
+    switch( p->pat[p->pos] ){
+        case '[':
+            ++(p->pos);
+            if( parse_class(p, a->set) ){
+                return 0;
+            }
+            break;
+
+        case '.':
+            ++(p->pos);
+            set_range(a->set, 0, 255);
+            a->set['\n' >> 3] &= ~(1 << ('\n' & 7));
+            break;
+
+        case '\\':
+            if( parse_escape(p, a->set, &c) == -1 ){
+                return 0;
+            }
+            break;
+
+        default:
+            SET_ADD(a->set, p->pat[p->pos]);
+            ++(p->pos);
+            break;
+    }
+
+    return a;
+}
+
+/* reads a decimal count for {n,m}, returns -1 if there is none */
+static int parse_count(struct Parser *p){
+    int n = -1;
+
+    while( p->pos < p->len && p->pat[p->pos] >= '0' && p->pat[p->pos] <= '9' ){
+        n = (n == -1 ? 0 : n * 10) + (p->pat[p->pos++] - '0');
+        if( n > DFA_MAX_REPEAT ){
+            printf("dfa_compile: repeat count larger than %d\n", DFA_MAX_REPEAT);
+            return -2;
+        }
+    }
+
+    return n;
+}
+
+static struct Ast * parse_repeat(struct Parser *p){
+    struct Ast *a = parse_atom(p);
+    struct Ast *r = 0;
+    int min = 0;
+    int max = 0;
+
+    while( a && p->pos < p->len ){
+        switch( p->pat[p->pos] ){
+            case '*':
+                min = 0;
+                max = -1;
+                break;
+            case '+':
+                min = 1;
+                max = -1;
+                break;
+            case '?':
+                min = 0;
+                max = 1;
+                break;
+
+            case '{':
+                ++(p->pos);
+                min = parse_count(p);
+                max = min;
+                if( min >= 0 && p->pos < p->len && p->pat[p->pos] == ',' ){
+                    ++(p->pos);
+                    max = parse_count(p);
+                    if( max == -2 ){
+                        return 0;
+                    }
+                }
+                if( min < 0 || p->pos >= p->len || p->pat[p->pos] != '}' ){
+                    if( min != -2 ){
+                        puts("dfa_compile: malformed repeat, expected {n}, {n,} or {n,m}");
+                    }
+                    return 0;
+                }
+                if( max != -1 && max < min ){
+                    printf("dfa_compile: repeat {%d,%d} has max below min\n", min, max);
+                    return 0;
+                }
+                break;
+
+            default:
+                return a;
+        }
+
+        /* skip '*', '+', '?' or '}' */
+        ++(p->pos);
+
+        r = ast_pair(p, AST_REPEAT, a, 0);
+        if( r ){
+            r->min = min;
+            r->max = max;
+        }
+        a = r;
+    }
+
+    return a;
+}
+
+static struct Ast * parse_cat(struct Parser *p){
+    struct Ast *cat = 0;
+    struct Ast *a = 0;
+
+    while( p->pos < p->len && p->pat[p->pos] != '|' && p->pat[p->pos] != ')' ){
+        a = parse_repeat(p);
+        if( ! a ){
+            return 0;
+        }
+        cat = cat ? ast_pair(p, AST_CAT, cat, a) : a;
+        if( ! cat ){
+            return 0;
+        }
+    }
+
+    return cat ? cat : ast_new(p, AST_EMPTY);
+}
+
+static struct Ast * parse_alt(struct Parser *p){
+    struct Ast *alt = parse_cat(p);
+
+    while( alt && p->pos < p->len && p->pat[p->pos] == '|' ){
+        ++(p->pos);
+        alt = ast_pair(p, AST_ALT, alt, parse_cat(p));
+        if( alt && ! alt->right ){
+            return 0;
+        }
+    }
+
+    return alt;
+}
+
+/* collects the bytes every match must start with into prefix
+ * returns 1 once something other than a single byte is reached
+ */
+static int ast_prefix(const struct Ast *a, char *prefix, size_t *n){
+    int c = 0;
+    int found = -1;
+
+    switch( a->type ){
+        case AST_CAT:
+            return ast_prefix(a->left, prefix, n) || ast_prefix(a->right, prefix, n);
+
+        /* zero width, a match starts in the same place either way */
+        case AST_BOL:
+        case AST_EOL:
+        case AST_EMPTY:
+            return 0;
+
+        case AST_SET:
+            for( c = 0; c < 256; ++c ){
+                if( SET_HAS(a->set, c) ){
+                    if( found != -1 ){
+                        return 1;
+                    }
+                    found = c;
+                }
+            }
+            if( found == -1 ){
+                return 1;
+            }
+            prefix[(*n)++] = (char)found;
+            return 0;
+
+        default:
+            return 1;
+    }
+}
+
+
+/***** nfa construction *****/
+
+static int node_new(struct Prog *prog, enum NodeType type, int out, int out1){
+    struct Node *nodes = 0;
+    size_t cap = 0;
+
+    if( prog->n >= prog->cap ){
+        if( prog->cap >= MAX_NODES ){
+            printf("dfa_compile: pattern needs more than %d states\n", MAX_NODES);
+            return -1;
+        }
+        cap = prog->cap ? 2 * prog->cap : 64;
+        nodes = realloc(prog->nodes, cap * sizeof(*nodes));
+        if( ! nodes ){
+            puts("dfa_compile: realloc failed");
+            return -1;
+        }
+        prog->nodes = nodes;
+        prog->cap = cap;
+    }
+
+    memset(&(prog->nodes[prog->n]), 0, sizeof(*nodes));
+    prog->nodes[prog->n].type = type;
+    prog->nodes[prog->n].out = out;
+    prog->nodes[prog->n].out1 = out1;
+    return prog->n++;
+}
+
+/* builds nodes for a which continue on to next
+ * nodes are built back to front so no patching is needed
+ * back builds the pattern reversed, for running over input from the end
+ *
+ * returns index of first node
+ * returns -1 on failure
+ */
+static int compile(struct Prog *prog, const struct Ast *a, int next, int back){
+    int start = next;
+    int body = 0;
+    int k = 0;
+
+    if( next < 0 ){
+        return -1;
+    }
+
+    switch( a->type ){
+        case AST_SET:
+            start = node_new(prog, NODE_SET, next, 0);
+            if( start >= 0 ){
+                memcpy(prog->nodes[start].set, a->set, SET_BYTES);
+            }
+            return start;
+
+        case AST_CAT:
+            if( back ){
+                return compile(prog, a->right, compile(prog, a->left, next, back), back);
+            }
+            return compile(prog, a->left, compile(prog, a->right, next, back), back);
+
+        case AST_ALT:
+            body = compile(prog, a->left, next, back);
+            start = compile(prog, a->right, next, back);
+            if( body < 0 || start < 0 ){
+                return -1;
+            }
+            return node_new(prog, NODE_SPLIT, body, start);
+
+        /* read backwards the start of a line is where a newline is ahead */
+        case AST_BOL:
+            return node_new(prog, back ? NODE_AHEAD : NODE_BEHIND, next, 0);
+        case AST_EOL:
+            return node_new(prog, back ? NODE_BEHIND : NODE_AHEAD, next, 0);
+
+        case AST_EMPTY:
+            return next;
+
+        case AST_REPEAT:
+            if( a->max == -1 ){
+                /* loop node goes round body or on to next */
+                start = node_new(prog, NODE_SPLIT, 0, next);
+                body = compile(prog, a->left, start, back);
+                if( body < 0 ){
+                    return -1;
+                }
+                prog->nodes[start].out = body;
+            } else {
+                /* optional copies nest, x{0,2} is (xx?)? */
+                for( k = a->min; k < a->max && start >= 0; ++k ){
+                    body = compile(prog, a->left, start, back);
+                    start = body < 0 ? -1 : node_new(prog, NODE_SPLIT, body, next);
+                }
+            }
+            for( k = 0; k < a->min && start >= 0; ++k ){
+                start = compile(prog, a->left, start, back);
+            }
+            return start;
+    }
+
+    return -1;
+}
+
+
+/***** dfa states *****/
+
+static int cmp_int(const void *a, const void *b){
+    return *(const int *)a - *(const int *)b;
+}
+
+static void push(struct Prog *prog, int *top, int node){
+    if( prog->mark[node] != prog->gen ){
+        prog->mark[node] = prog->gen;
+        prog->stack[(*top)++] = node;
+    }
+}
+
+/* follows every path from in[0, n) that doesn't consume a byte
+ * keeping the nodes that either consume one, match, or wait on what is ahead
+ * behind and ahead say whether the byte on either side is a newline or absent
+ *
+ * writes sorted result to out, returns its length
+ */
+static size_t closure(struct Prog *prog, const int *in, size_t n, int behind, int ahead, int *out){
+    const struct Node *node = 0;
+    size_t len = 0;
+    size_t i = 0;
+    int top = 0;
+    int x = 0;
+
+    if( ++(prog->gen) == 0 ){
+        memset(prog->mark, 0, prog->n * sizeof(*(prog->mark)));
+        prog->gen = 1;
+    }
+
+    for( i = 0; i < n; ++i ){
+        push(prog, &top, in[i]);
+    }
+
+    while( top ){
+        x = prog->stack[--top];
+        node = &(prog->nodes[x]);
+        switch( node->type ){
+            case NODE_SPLIT:
+                push(prog, &top, node->out);
+                push(prog, &top, node->out1);
+                break;
+
+            case NODE_BEHIND:
+                if( behind ){
+                    push(prog, &top, node->out);
+                }
+                break;
+
+            case NODE_AHEAD:
+                if( ahead ){
+                    push(prog, &top, node->out);
+                } else {
+                    out[len++] = x;
+                }
+                break;
+
+            default:
+                out[len++] = x;
+                break;
+        }
+    }
+
+    qsort(out, len, sizeof(*out), cmp_int);
+    return len;
+}
+
+static unsigned int state_hash(const int *nodes, size_t n, int behind){
+    unsigned int h = 2166136261u ^ (unsigned int)behind;
+    size_t i = 0;
+
+    for( i = 0; i < n; ++i ){
+        h = (h ^ (unsigned int)nodes[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+static struct DState * state_find(struct Prog *prog, const int *nodes, size_t n, int behind, unsigned int h){
+    struct DState *s = 0;
+
+    for( s = prog->table[h % HASH_SIZE]; s; s = s->chain ){
+        if( s->hash == h && s->behind == behind && s->n == n
+            && ! memcmp(s->nodes, nodes, n * sizeof(*nodes)) ){
+            return s;
+        }
+    }
+
+    return 0;
+}
+
+static void flush(struct Prog *prog){
+    struct DState *s = 0;
+    struct DState *next = 0;
+    size_t i = 0;
+
+    for( i = 0; i < HASH_SIZE; ++i ){
+        for( s = prog->table[i]; s; s = next ){
+            next = s->chain;
+            free(s);
+        }
+        prog->table[i] = 0;
+    }
+
+    prog->states = 0;
+    prog->starts[0] = 0;
+    prog->starts[1] = 0;
+}
+
+static int make_starts(struct Prog *prog);
+
+/* returns the state for nodes[0, n), building it if not already cached
+ * a full cache is flushed first, *flushed is then set and any state
+ * pointers held by the caller are no longer valid
+ *
+ * returns 0 if out of memory
+ */
+static struct DState * intern(struct Prog *prog, const int *nodes, size_t n, int behind, int *flushed){
+    struct DState *s = 0;
+    struct DState *found = 0;
+    unsigned int h = state_hash(nodes, n, behind);
+    size_t i = 0;
+
+    s = state_find(prog, nodes, n, behind, h);
+    if( s ){
+        return s;
+    }
+
+    s = malloc(sizeof(*s) + n * sizeof(*nodes));
+    if( ! s ){
+        puts("dfa: malloc failed");
+        return 0;
+    }
+
+    memset(s->next, 0, sizeof(s->next));
+    memcpy(s->nodes, nodes, n * sizeof(*nodes));
+    s->n = n;
+    s->hash = h;
+    s->behind = behind;
+    s->flags = n ? 0 : STATE_DEAD;
+
+    for( i = 0; i < n; ++i ){
+        if( prog->nodes[nodes[i]].type == NODE_MATCH ){
+            s->flags |= STATE_MATCH;
+        }
+        if( prog->nodes[nodes[i]].type == NODE_AHEAD ){
+            s->flags |= STATE_AHEAD;
+        }
+    }
+
+    /* only worth flagging if a newline ahead would lead to a match */
+    if( (s->flags & STATE_AHEAD) && ! (s->flags & STATE_MATCH) ){
+        s->flags &= ~STATE_AHEAD;
+        n = closure(prog, s->nodes, s->n, behind, 1, prog->ahead);
+        for( i = 0; i < n; ++i ){
+            if( prog->nodes[prog->ahead[i]].type == NODE_MATCH ){
+                s->flags |= STATE_AHEAD;
+            }
+        }
+    }
+
+    if( prog->states >= MAX_STATES ){
+        flush(prog);
+        *flushed = 1;
+        if( make_starts(prog) ){
+            free(s);
+            return 0;
+        }
+        /* may have just been rebuilt as a start state */
+        found = state_find(prog, s->nodes, s->n, behind, h);
+        if( found ){
+            free(s);
+            return found;
+        }
+    }
+
+    s->chain = prog->table[h % HASH_SIZE];
+    prog->table[h % HASH_SIZE] = s;
+    ++(prog->states);
+    return s;
+}
+
+static int make_starts(struct Prog *prog){
+    struct DState *s = 0;
+    size_t n = 0;
+    int flushed = 0;
+    int behind = 0;
+
+    for( behind = 0; behind < 2; ++behind ){
+        n = closure(prog, &(prog->start), 1, behind, 0, prog->closed);
+        s = intern(prog, prog->closed, n, behind, &flushed);
+        if( ! s ){
+            return 1;
+        }
+        if( prog->prefilter ){
+            s->flags |= STATE_START;
+        }
+        prog->starts[behind] = s;
+    }
+
+    return 0;
+}
+
+/* builds the transition from s on byte c, caching it in s->next
+ * returns 0 if out of memory
+ */
+static struct DState * step(struct Prog *prog, struct DState *s, unsigned char c){
+    struct DState *to = 0;
+    const int *from = s->nodes;
+    size_t n = s->n;
+    size_t moved = 0;
+    size_t i = 0;
+    int flushed = 0;
+
+    /* a newline ahead lets through anything waiting on end of line */
+    if( c == '\n' ){
+        n = closure(prog, s->nodes, s->n, s->behind, 1, prog->expand);
+        from = prog->expand;
+    }
+
+    for( i = 0; i < n; ++i ){
+        if( prog->nodes[from[i]].type == NODE_SET && SET_HAS(prog->nodes[from[i]].set, c) ){
+            prog->moved[moved++] = prog->nodes[from[i]].out;
+        }
+    }
+
+    n = closure(prog, prog->moved, moved, c == '\n', 0, prog->closed);
+    to = intern(prog, prog->closed, n, c == '\n', &flushed);
+    if( to && ! flushed ){
+        s->next[c] = to;
+    }
+
+    return to;
+}
+
+static void prog_free(struct Prog *prog){
+    flush(prog);
+    free(prog->nodes);
+    free(prog->mark);
+    free(prog->stack);
+    free(prog->expand);
+    free(prog->moved);
+    free(prog->closed);
+    free(prog->ahead);
+}
+
+/* builds prog for tree, forward progs find matches starting anywhere
+ * returns 0 on success
+ * returns 1 on failure
+ */
+static int prog_init(struct Prog *prog, const struct Ast *tree, int back, int prefilter){
+    int match = 0;
+    int loop = 0;
+    int any = 0;
+
+    memset(prog, 0, sizeof(*prog));
+
+    match = node_new(prog, NODE_MATCH, 0, 0);
+    prog->start = compile(prog, tree, match, back);
+    if( prog->start < 0 ){
+        return 1;
+    }
+
+    if( ! back ){
+        /* loop: either start the pattern here, or skip a byte and come back */
+        loop = node_new(prog, NODE_SPLIT, prog->start, 0);
+        any = node_new(prog, NODE_SET, loop, 0);
+        if( loop < 0 || any < 0 ){
+            return 1;
+        }
+        set_range(prog->nodes[any].set, 0, 255);
+        prog->nodes[loop].out1 = any;
+        prog->start = loop;
+        prog->prefilter = prefilter;
+    }
+
+    prog->mark = calloc(prog->n, sizeof(*(prog->mark)));
+    prog->stack = malloc(prog->n * sizeof(int));
+    prog->expand = malloc(prog->n * sizeof(int));
+    prog->moved = malloc(prog->n * sizeof(int));
+    prog->closed = malloc(prog->n * sizeof(int));
+    prog->ahead = malloc(prog->n * sizeof(int));
+    if( ! prog->mark || ! prog->stack || ! prog->expand || ! prog->moved || ! prog->closed || ! prog->ahead ){
+        puts("dfa_compile: malloc failed");
+        return 1;
+    }
+
+    return make_starts(prog);
+}
+
+
+/***** interface *****/
+
+struct Dfa * dfa_compile(const char *pattern, size_t len){
+    struct Parser p;
+    struct Ast *tree = 0;
+    struct Dfa *dfa = 0;
+    size_t n = 0;
+
+    memset(&p, 0, sizeof(p));
+    p.pat = pattern;
+    p.len = len;
+    /* at most an atom, a join and a repeat per byte, plus an empty */
+    p.cap = 3 * len + 1;
+    p.pool = malloc(p.cap * sizeof(*(p.pool)));
+    if( ! p.pool ){
+        puts("dfa_compile: malloc failed");
+        return 0;
+    }
+
+    tree = parse_alt(&p);
+    if( tree && p.pos < len ){
+        printf("dfa_compile: unmatched ')' at offset %zu\n", p.pos);
+        tree = 0;
+    }
+    if( ! tree ){
+        goto EXIT;
+    }
+
+    dfa = calloc(1, sizeof(*dfa));
+    if( ! dfa ){
+        puts("dfa_compile: calloc failed");
+        goto EXIT;
+    }
+
+    dfa->prefix = malloc(len + 1);
+    if( ! dfa->prefix ){
+        puts("dfa_compile: malloc failed");
+        goto FAIL;
+    }
+    ast_prefix(tree, dfa->prefix, &n);
+    if( n ){
+        scan_needle(&(dfa->literal), dfa->prefix, n);
+    }
+
+    if( prog_init(&(dfa->fwd), tree, 0, n > 0) || prog_init(&(dfa->back), tree, 1, 0) ){
+        goto FAIL;
+    }
+
+    goto EXIT;
+
+FAIL:
+    dfa_free(dfa);
+    dfa = 0;
+
+EXIT:
+    free(p.pool);
+    return dfa;
+}
+
+void dfa_free(struct Dfa *dfa){
+    if( ! dfa ){
+        return;
+    }
+
+    prog_free(&(dfa->fwd));
+    prog_free(&(dfa->back));
+    free(dfa->prefix);
+    free(dfa);
+}
+
+int dfa_begin(struct DfaRun *run, struct Dfa *dfa, int back, int boundary){
+    struct Prog *prog = back ? &(dfa->back) : &(dfa->fwd);
+
+    if( ! prog->starts[0] && make_starts(prog) ){
+        return -1;
+    }
+
+    run->dfa = dfa;
+    run->back = back;
+    run->state = prog->starts[boundary ? 1 : 0];
+    run->count = 0;
+    run->match = DFA_NONE;
+    return 0;
+}
+
+/* forward run, stops at the first position a match ends */
+static int scan_forward(struct DfaRun *run, const char *buf, size_t len){
+    struct Prog *prog = &(run->dfa->fwd);
+    const struct Needle *literal = &(run->dfa->literal);
+    struct DState *s = run->state;
+    struct DState *to = 0;
+    size_t skip = 0;
+    size_t i = 0;
+
+    while( i < len ){
+        if( s->flags ){
+            if( (s->flags & STATE_MATCH) || ((s->flags & STATE_AHEAD) && buf[i] == '\n') ){
+                run->count += i;
+                run->match = run->count;
+                run->state = s;
+                return DFA_MATCH;
+            }
+
+            /* no match in progress, so none can start before the next
+             * occurrence of the prefix, or a partial one at the end of buf
+             */
+            if( s->flags & STATE_START ){
+                skip = scan_find(literal, buf + i, len - i);
+                if( skip == SCAN_NONE ){
+                    skip = len - i >= literal->len ? len - i - literal->len + 1 : 0;
+                }
+                if( skip ){
+                    i += skip;
+                    s = prog->starts[buf[i - 1] == '\n'];
+                    continue;
+                }
+            }
+        }
+
+        to = s->next[(unsigned char)buf[i]];
+        if( ! to ){
+            to = step(prog, s, buf[i]);
+            if( ! to ){
+                return -1;
+            }
+        }
+        s = to;
+        ++i;
+    }
+
+    run->count += len;
+    run->state = s;
+    return DFA_MORE;
+}
+
+/* backward run, keeps going while a longer match is possible */
+static int scan_backward(struct DfaRun *run, const char *buf, size_t len){
+    struct Prog *prog = &(run->dfa->back);
+    struct DState *s = run->state;
+    struct DState *to = 0;
+    size_t i = 0;
+
+    for( i = len; i > 0; --i ){
+        if( s->flags ){
+            if( s->flags & STATE_DEAD ){
+                run->count += len - i;
+                run->state = s;
+                return DFA_DEAD;
+            }
+            if( (s->flags & STATE_MATCH) || ((s->flags & STATE_AHEAD) && buf[i - 1] == '\n') ){
+                run->match = run->count + (len - i);
+            }
+        }
+
+        to = s->next[(unsigned char)buf[i - 1]];
+        if( ! to ){
+            to = step(prog, s, buf[i - 1]);
+            if( ! to ){
+                return -1;
+            }
+        }
+        s = to;
+    }
+
+    run->count += len;
+    run->state = s;
+    return (s->flags & STATE_DEAD) ? DFA_DEAD : DFA_MORE;
+}
+
+int dfa_scan(struct DfaRun *run, const char *buf, size_t len){
+    return run->back ? scan_backward(run, buf, len) : scan_forward(run, buf, len);
+}
+
+void dfa_finish(struct DfaRun *run, int boundary){
+    struct DState *s = run->state;
+
+    /* forward runs keep the earliest match */
+    if( ! run->back && run->match != DFA_NONE ){
+        return;
+    }
+
+    if( (s->flags & STATE_MATCH) || ((s->flags & STATE_AHEAD) && boundary) ){
+        run->match = run->count;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef DODO_DFA_H
+#define DODO_DFA_H
+
+#include <stddef.h> /* size_t */
+
+/* regular expressions run as a lazily built dfa
+ *
+ * the pattern is compiled once into a thompson nfa for each direction,
+ * dfa states are sets of nfa states built the first time a transition is
+ * taken and cached, so every byte costs one table lookup and nothing is
+ * ever backtracked
+ *
+ * supported syntax
+ *  c         literal byte, \c for any of the special bytes below
+ *  .         any byte except newline
+ *  [abc]     one of a set of bytes, ranges a-z, negated by a leading ^
+ *  \d \w \s  digit, word and space bytes, \D \W \S for their complements
+ *  \n \t \r  newline, tab and carriage return
+ *  ^ $       start and end of a line
+ *  (re)      grouping
+ *  re|re     either
+ *  re* re+ re?          zero or more, one or more, zero or one
+ *  re{n} re{n,} re{n,m}  between n and m, m at most DFA_MAX_REPEAT
+ *
+ * input is fed a block at a time through a struct DfaRun which carries
+ * state across blocks, in either direction
+ */
+
+#define DFA_MAX_REPEAT 255
+
+/* returned by dfa_scan */
+/* all of buf consumed, feed the next block */
+#define DFA_MORE 0
+/* forward run only, earliest match ends at run->match */
+#define DFA_MATCH 1
+/* no match can be extended any further */
+#define DFA_DEAD 2
+
+/* no match seen yet */
+#define DFA_NONE ((unsigned long long)-1)
+
+struct Dfa;
+
+struct DfaRun {
+    struct Dfa *dfa;
+    /* 0 forward, 1 backward */
+    int back;
+    /* current dfa state */
+    void *state;
+    /* bytes consumed so far */
+    unsigned long long count;
+    /* value of count where a match ends, DFA_NONE if there is none
+     * forward runs stop on the earliest match end
+     * backward runs keep the longest match
+     */
+    unsigned long long match;
+};
+
+/* compiles pattern[0, len)
+ * returns dfa on success
+ * returns 0 on failure, after printing why
+ */
+struct Dfa * dfa_compile(const char *pattern, size_t len);
+
+void dfa_free(struct Dfa *dfa);
+
+/* starts a run over dfa
+ *
+ * forward runs look for a match starting anywhere at or after the first
+ * byte fed, backward runs only for one ending at the first byte fed
+ *
+ * boundary is 1 if the byte before the first one fed, in the direction of
+ * the run, is a newline or there is no such byte
+ *
+ * returns 0 on success
+ * returns -1 if out of memory
+ */
+int dfa_begin(struct DfaRun *run, struct Dfa *dfa, int back, int boundary);
+
+/* feeds buf[0, len) to run, backward runs consume it from the end
+ * returns one of DFA_MORE, DFA_MATCH or DFA_DEAD
+ * returns -1 if out of memory
+ */
+int dfa_scan(struct DfaRun *run, const char *buf, size_t len);
+
+/* ends run, boundary is 1 if the run stopped at end of input or
+ * in front of a newline
+ * sets run->match if a match ends here
+ */
+void dfa_finish(struct DfaRun *run, int boundary);
+
+#endif /* DODO_DFA_H */
@@ -1,8 +1,27 @@
-#include <unistd.h> /* truncate */
-#include <stdio.h> /* fopen, fseek, fread, fwrite, FILE */
+#ifdef __linux__
+/* copy_file_range, syscall */
+#define _GNU_SOURCE
+#include <sys/sendfile.h> /* sendfile */
+#include <sys/syscall.h> /* __NR_io_uring_setup, __NR_io_uring_enter */
+#include <linux/io_uring.h> /* io_uring_params, io_uring_sqe, io_uring_cqe */
+/* from linux/fs.h, which it includes, dodo has its own */
+#undef BLOCK_SIZE
+#endif
+#include <unistd.h> /* pread, pwrite, ftruncate, close, copy_file_range */
+#include <stdio.h> /* fopen, fseeko, fread, fwrite, FILE */
+#include <fcntl.h> /* open */
+#include <sys/mman.h> /* mmap, munmap, posix_madvise */
 #include <stdlib.h> /* exit */
 #include <string.h> /* strcmp, strncmp */
 #include <ctype.h> /* isdigit */
+#include <sys/types.h> /* dev_t, ino_t, off_t */
+#include <sys/stat.h> /* fstat */
+#include <errno.h> /* errno */
+#include <pthread.h> /* pthread_create, pthread_join, pthread_mutex_lock */
+
+#include "scan.h" /* scan_newlines, scan_hex */
+#include "hash.h" /* hash_crc32c, hash_combine */
+#include "dfa.h" /* dfa_compile, dfa_scan */
 
 
 /***** data structures and manipulation *****/
@@ -13,24 +32,85 @@ enum Command {
      * $num defaults to 100 if not supplied
      */
     PRINT,
-    /* takes num
+    /* optionally takes num
+     * copies $num bytes to stdout as they are, with nothing around them
+     * $num defaults to 100 if not supplied
+     */
+    RAW,
+    /* optionally takes num
+     * prints $num bytes in hex, a line for every 32 led by its offset
+     * $num defaults to 100 if not supplied
+     */
+    HEXDUMP,
+    /* takes num and whence
      * goto line in file
+     *  SEEK_SET: line num counting from start of file
+     *  SEEK_CUR: num lines after (or before if negative) line holding cursor
+     *  SEEK_END: num lines before (num <= 0) last line of file
      */
     LINE,
     /* takes num
      * goto byte in file
      */
     BYTE,
+    /* takes string
+     * goto first match of string at or after cursor
+     * exits with code EXIT_FAILURE if there is no match
+     */
+    SEARCH,
+    /* takes string
+     * goto last match of string starting before cursor
+     * exits with code EXIT_FAILURE if there is no match
+     */
+    SEARCH_BACK,
+    /* takes string, compiled into dfa when parsed
+     * goto start of first match of regular expression at or after cursor,
+     * matches are taken in order of where they end
+     * exits with code EXIT_FAILURE if there is no match
+     */
+    REGEX,
     /* takes string
      * compares string to current file location
      * exits with code EXIT_FAILURE if string doesn't match
      */
     EXPECT,
+    /* takes num and count
+     * compares num to crc32c of count bytes at current file location,
+     * count -1 checks up to end of file
+     * exits with code EXIT_FAILURE if it doesn't match
+     */
+    EXPECT_HASH,
+    /* takes count
+     * prints crc32c of count bytes at current file location as EXPECT_HASH,
+     * count -1 hashes up to end of file
+     */
+    HASH,
     /* takes string
      * writes string to current location in file
      * leaves the cursor positioned after the write
      */
     WRITE,
+    /* takes string, a path, and byte range from and count
+     * copies count bytes of the file at path starting at from
+     * to current location in file, count -1 copies the rest of it
+     * leaves the cursor positioned after the copy
+     */
+    WRITE_FILE,
+    /* takes string and replace, both num bytes long
+     * replaces every occurrence of string in the file with replace
+     * reports number of matches and bytes rewritten, cursor does not move
+     */
+    SUBSTITUTE,
+    /* takes string
+     * inserts string at cursor, moving the rest of the file along
+     * leaves the cursor positioned after the insert
+     */
+    INSERT,
+    /* optionally takes num
+     * removes num bytes at cursor, moving the rest of the file back
+     * $num defaults to 1 if not supplied
+     */
+    DELETE,
     /* truncates file at cursor position
      */
     TRUNCATE,
@@ -42,45 +122,263 @@ enum Command {
 /* interpretation depends on Command */
 struct Argument {
     /* either numeric argument OR length of string */
-    long int num;
+    long long int num;
     char *str;
+    /* what num is relative to, as for fseek
+     * one of SEEK_SET, SEEK_CUR or SEEK_END
+     */
+    int whence;
+    /* pattern for REGEX compiled from str */
+    struct Dfa *dfa;
+    /* replacement for SUBSTITUTE, num bytes long like str */
+    char *replace;
+    /* byte range of the file WRITE_FILE copies from,
+     * count is also the number of bytes HASH and EXPECT_HASH cover
+     */
+    long long int from;
+    long long int count;
 };
 
+/* programs are a contiguous array of these, run from first to last */
 struct Instruction {
     /* type of command determines dispatch to eval_ function
      * which in turn determines interpretation of argument
      */
     enum Command command;
     struct Argument argument;
-    /* next Instruction in linked list */
-    struct Instruction *next;
+};
+
+/* length-changing edit waiting to be applied
+ * remove bytes at offset in the file as it is on disk are replaced by
+ * len bytes of str
+ */
+struct Edit {
+    off_t offset;
+    off_t remove;
+    char *str;
+    size_t len;
+};
+
+/* inserts, deletes and writes collect here as they execute, and are applied
+ * together in one pass over the file once a command needs to see the file as
+ * edited, writes next to or over each other merge into a single edit
+ * edits are sorted by offset and never overlap
+ */
+struct Pending {
+    struct Edit *edits;
+    size_t len;
+    size_t cap;
+    /* change in file length once applied */
+    off_t delta;
+    /* buffer edited bytes are put together in for print and expect */
+    char *buf;
+    size_t buf_len;
+};
+
+/* most edits held at once, edits arriving out of order cost a move of
+ * those after them so they are applied once there are this many
+ */
+#define PENDING_MAX 1024
+
+/* number of lines between checkpoints in the line index */
+#define INDEX_INTERVAL 1024
+/* suffix appended to the file path to name the sidecar index */
+#define INDEX_SUFFIX ".dodoidx"
+#define INDEX_MAGIC "dodoidx"
+#define INDEX_VERSION 2
+
+/* header of on-disk line index
+ * the index is a cache written in host byte order,
+ * it is only trusted if the file still matches the identity recorded here
+ */
+struct IndexHeader {
+    char magic[8];
+    long int version;
+    long int interval;
+    /* identity of indexed file at the time the index was written */
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime_sec;
+    long int mtime_nsec;
+    /* number of checkpoints following header */
+    size_t len;
+};
+
+/* sparse line index
+ * checkpoints[k] is the byte offset of the start of line (k * INDEX_INTERVAL) + 1
+ * so checkpoints[0] is always 0
+ * only a prefix of the checkpoints is ever known, it grows as lines are visited
+ */
+struct Index {
+    /* path to sidecar index file */
+    char *path;
+    off_t *checkpoints;
+    /* number of known checkpoints */
+    size_t len;
+    /* number of allocated checkpoints */
+    size_t cap;
+    /* set when the sidecar no longer reflects this index */
+    int dirty;
+};
+
+#define COMPILED_MAGIC "dodoc"
+#define COMPILED_VERSION 1
+/* FNV-1a offset basis */
+#define COMPILED_HASH_INIT 0xcbf29ce484222325ULL
+
+/* header of compiled program, written by --compile and mapped by --load
+ * like the line index it is written in host byte order
+ * followed by len records, then strings bytes the records point into
+ */
+struct CompiledHeader {
+    char magic[8];
+    long int version;
+    /* number of records following header */
+    size_t len;
+    /* number of string bytes following records */
+    size_t strings;
+    /* compiled_hash of everything following header */
+    unsigned long long hash;
+};
+
+/* Instruction as saved in a compiled program */
+struct CompiledRecord {
+    long long int num;
+    /* offsets of str and replace into the string bytes, -1 if not set
+     * every string is followed by a null byte
+     */
+    long long int str;
+    long long int replace;
+    long long int from;
+    long long int count;
+    int command;
+    int whence;
+};
+
+struct Program;
+
+/* I/O engine a Program uses to access its file
+ * eval_ functions only go through these, so do not care which engine is active
+ * all offsets are absolute, engines keep no cursor of their own
+ */
+struct Engine {
+    const char *name;
+    /* open p->path, setting p->fd
+     * returns 0 on success
+     * returns 1 on failure
+     */
+    int (*open)(struct Program *p);
+    /* release everything open acquired */
+    void (*close)(struct Program *p);
+    /* make up to len bytes at offset available, *nr is set to number available
+     * engines that copy read into buf, or into get_buffer if buf is 0
+     * returns pointer to data on success
+     * returns 0 on failure
+     */
+    const char * (*view)(struct Program *p, char *buf, size_t len, off_t offset, size_t *nr);
+    /* write len bytes of buf at offset, extending file if needed
+     * returns number of bytes written
+     */
+    size_t (*write)(struct Program *p, const char *buf, size_t len, off_t offset);
+    /* copy len bytes of file open as fd from its offset from to offset,
+     * extending file if needed, without the bytes passing through dodo
+     * returns number of bytes copied
+     */
+    size_t (*copy)(struct Program *p, int fd, off_t from, size_t len, off_t offset);
+    /* set file length to len
+     * returns 0 on success
+     * returns 1 on failure
+     */
+    int (*truncate)(struct Program *p, off_t len);
+    /* returns length of file, or -1 on failure */
+    off_t (*size)(struct Program *p);
+    /* hint that the cursor has moved to offset */
+    void (*seek)(struct Program *p, off_t offset);
+    /* hint that len bytes at offset will be viewed soon, never waits */
+    void (*fetch)(struct Program *p, off_t offset, size_t len);
+    /* wait for writes still under way
+     * returns 0 on success
+     * returns 1 if any failed
+     */
+    int (*flush)(struct Program *p);
 };
 
 struct Program {
-    /* linked list of Instruction(s) */
-    struct Instruction *start;
+    /* array of Instruction(s), code_cap allocated and code_len in use
+     * string arguments point into source, which escapes are decoded within
+     */
+    struct Instruction *code;
+    size_t code_len;
+    size_t code_cap;
     /* path to file program is operating on */
     char *path;
-    /* file program is operating on */
+    /* engine used to access file */
+    const struct Engine *engine;
+    /* file descriptor of file program is operating on, -1 if not open */
+    int fd;
+    /* file program is operating on, for stdio engine */
     FILE *file;
+    /* mapping of whole file and its length, for mmap engine */
+    char *map;
+    size_t map_len;
+    /* submission and completion rings, for io_uring engine */
+    struct Uring *uring;
+    /* file is open O_DIRECT, so reads and writes of it must be aligned */
+    int direct;
+    /* buffer aligned to DIRECT_ALIGN and its length, for direct engine */
+    char *aligned;
+    size_t aligned_len;
     /* current offset into file */
-    long int offset;
+    off_t offset;
     /* program source read into a buffer */
     char *source;
+    /* mapping of compiled program loaded instead of source, and its length */
+    char *image;
+    size_t image_len;
     /* shared buffer (and length) used for reading into */
     char *buf;
     size_t buf_len;
+    /* optional line index, 0 if not in use */
+    struct Index *index;
+    /* aligned buffer of BLOCK_SIZE bytes used for scanning through file */
+    char *block;
+    /* number of worker threads for line seeks, sequential if < 2 */
+    int jobs;
+    /* buffers for parallel workers, see get_chunks */
+    char *chunks;
+    /* inserts and deletes not yet applied to the file */
+    struct Pending pending;
+    /* run stretches of b, e and w commands in order of offset */
+    int plan;
+    /* check expects with known offsets before running anything */
+    int verify;
+    /* ask the kernel for the bytes of instructions ahead before they run */
+    int prefetch;
 };
 
-struct Instruction * new_instruction(enum Command command){
+/* return zeroed instruction in the next free slot of p->code
+ * it only becomes part of the program once parse counts it in p->code_len
+ * returns 0 on error
+ */
+struct Instruction * new_instruction(struct Program *p, enum Command command){
+    struct Instruction *code = 0;
     struct Instruction *i = 0;
+    size_t cap = 0;
 
-    i = calloc(1, sizeof(struct Instruction));
-    if( ! i ){
-        puts("new_instruction: call to calloc failed");
-        return 0;
+    if( p->code_len == p->code_cap ){
+        cap = p->code_cap ? 2 * p->code_cap : 64;
+        code = realloc(p->code, cap * sizeof(*code));
+        if( ! code ){
+            puts("new_instruction: call to realloc failed");
+            return 0;
+        }
+        p->code = code;
+        p->code_cap = cap;
     }
 
+    i = &(p->code[p->code_len]);
+    memset(i, 0, sizeof(*i));
     i->command = command;
 
     return i;
@@ -110,9 +408,200 @@ char * get_buffer(struct Program *p, size_t required_len){
     return p->buf;
 }
 
+/* size of reads made when scanning through file */
+#define BLOCK_SIZE (1 << 20)
+/* alignment of offsets, lengths and buffers of reads and writes of a file opened O_DIRECT,
+ * a page, which suits any logical block size
+ */
+#define DIRECT_ALIGN 4096
+/* alignment of block buffer, suits any vector width scan.c uses and O_DIRECT reads */
+#define BLOCK_ALIGN DIRECT_ALIGN
+
+/* return the block buffer of BLOCK_SIZE bytes
+ * returns 0 on error
+ */
+char * get_block(struct Program *p){
+    void *block = 0;
+
+    if( p->block ){
+        return p->block;
+    }
+
+    if( posix_memalign(&block, BLOCK_ALIGN, BLOCK_SIZE) ){
+        puts("get_block: failed to allocate block");
+        return 0;
+    }
+
+    p->block = block;
+    return p->block;
+}
+
+/* read len bytes at offset of fd, which is open O_DIRECT, into buf
+ * buf is aligned to DIRECT_ALIGN with room for len + 2 * DIRECT_ALIGN bytes,
+ * the read is widened to aligned bounds and the bytes wanted then moved to the start of buf
+ * returns number of bytes read, short only at end of file
+ * returns -1 on failure, with errno set
+ */
+ssize_t pread_aligned(int fd, char *buf, size_t len, off_t offset){
+    off_t start = offset - offset % DIRECT_ALIGN;
+    size_t skip = offset - start;
+    size_t total = (skip + len + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+    size_t got = 0;
+    ssize_t ret = 0;
+
+    /* only the end of the file makes a read short, and it need not be aligned */
+    while( got < total ){
+        ret = pread(fd, buf + got, total - got, start + got);
+        if( ret == -1 && errno == EINTR ){
+            continue;
+        }
+        if( ret == -1 ){
+            return -1;
+        }
+        got += ret;
+        if( ret == 0 || got % DIRECT_ALIGN ){
+            break;
+        }
+    }
+
+    got = got > skip ? got - skip : 0;
+    got = got < len ? got : len;
+    if( skip ){
+        memmove(buf, buf + skip, got);
+    }
+
+    return got;
+}
+
+/* read len bytes at offset of fd into buf, stopping short only at end of file
+ * if direct fd is open O_DIRECT, and buf is as pread_aligned needs
+ * returns number of bytes read
+ * returns -1 on failure, with errno set
+ */
+ssize_t pread_full(int fd, int direct, char *buf, size_t len, off_t offset){
+    size_t got = 0;
+    ssize_t ret = 0;
+
+    if( direct ){
+        return pread_aligned(fd, buf, len, offset);
+    }
+
+    while( got < len ){
+        ret = pread(fd, buf + got, len - got, offset + got);
+        if( ret == -1 && errno == EINTR ){
+            continue;
+        }
+        if( ret == -1 ){
+            return -1;
+        }
+        if( ret == 0 ){
+            break;
+        }
+        got += ret;
+    }
+
+    return got;
+}
+
+/* copy len bytes of file open as fd at from to p->fd at offset
+ * copy_file_range keeps the bytes within the kernel, sharing them outright
+ * on filesystems that can, sendfile stands in where it is refused
+ * (across filesystems before linux 5.3, or without it at all)
+ * and failing both the bytes go through the block buffer
+ *
+ * returns number of bytes copied
+ */
+size_t copy_range(struct Program *p, int fd, off_t from, size_t len, off_t offset){
+    ssize_t ret = 0;
+    size_t nw = 0;
+    char *block = 0;
+    size_t want = 0;
+#ifdef __linux__
+    loff_t in = 0;
+    loff_t out = 0;
+    off_t at = 0;
+
+    for( nw = 0; nw < len; nw += ret ){
+        in = from + nw;
+        out = offset + nw;
+        ret = copy_file_range(fd, &in, p->fd, &out, len - nw, 0);
+        if( ret == -1 && errno == EINTR ){
+            ret = 0;
+            continue;
+        }
+        if( ret == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP) ){
+            break;
+        }
+        if( ret == -1 ){
+            perror("copy_range: error in call to copy_file_range");
+            return nw;
+        }
+        if( ret == 0 ){
+            /* source ended early */
+            return nw;
+        }
+    }
+
+    /* sendfile writes at the file position of p->fd */
+    if( nw < len && lseek(p->fd, offset + nw, SEEK_SET) != -1 ){
+        for( ; nw < len; nw += ret ){
+            at = from + nw;
+            ret = sendfile(p->fd, fd, &at, len - nw);
+            if( ret == -1 && errno == EINTR ){
+                ret = 0;
+                continue;
+            }
+            if( ret == -1 && (errno == EINVAL || errno == ENOSYS) ){
+                break;
+            }
+            if( ret == -1 ){
+                perror("copy_range: error in call to sendfile");
+                return nw;
+            }
+            if( ret == 0 ){
+                return nw;
+            }
+        }
+    }
+#endif
+
+    if( nw == len ){
+        return nw;
+    }
+
+    block = get_block(p);
+    if( ! block ){
+        puts("copy_range: call to get_block failed");
+        return nw;
+    }
+
+    for( ; nw < len; nw += ret ){
+        want = len - nw < BLOCK_SIZE ? len - nw : BLOCK_SIZE;
+        ret = pread(fd, block, want, from + nw);
+        if( ret == -1 && errno == EINTR ){
+            ret = 0;
+            continue;
+        }
+        if( ret == -1 ){
+            perror("copy_range: error in call to pread");
+            break;
+        }
+        if( ret == 0 ){
+            break;
+        }
+        if( pwrite(p->fd, block, ret, offset + nw) != ret ){
+            perror("copy_range: error in call to pwrite");
+            break;
+        }
+    }
+
+    return nw;
+}
+
 #define BUF_INCR 1024
 
 /* return a char* containing data from provided FILE*
+ * the buffer doubles as it fills, so reading n bytes copies O(n) of them
  * returns 0 on error
  */
 char * slurp(FILE *file){
@@ -120,30 +609,36 @@ char * slurp(FILE *file){
     size_t offset = 0;
     size_t nr = 0;
     char *buf = 0;
+    char *grown = 0;
 
     if( ! file ){
         return 0;
     }
 
-    buf = calloc(size, 1);
+    buf = malloc(size);
     if( ! buf ){
         return 0;
     }
 
-    while( BUF_INCR == (nr = fread(&(buf[offset]), 1, BUF_INCR, file)) ){
-        offset = size;
-        size += BUF_INCR;
-
-        buf = realloc(buf, size);
+    /* keep a byte spare for the terminator */
+    while( size - 1 - offset == (nr = fread(&(buf[offset]), 1, size - 1 - offset, file)) ){
+        offset += nr;
+        size *= 2;
 
-        if( ! buf ){
+        grown = realloc(buf, size);
+        if( ! grown ){
+            free(buf);
             return 0;
         }
+        buf = grown;
     }
+    offset += nr;
+    buf[offset] = '\0';
 
     /* check for fread errors */
     if( ferror(file) ){
         puts("slurp: file read failed");
+        free(buf);
         return 0;
     }
 
@@ -151,946 +646,6555 @@ char * slurp(FILE *file){
 }
 
 
-/***** parsing functions *****/
+/***** I/O engines *****/
 
-/* parsing helper method for parsing a string argument to a command
- * used for expect e/string/
- * and for write w/string/
- *
- * source must be a c-string meaning that is is an array of characters
- * terminated by the null-terminator ('\0')
- *
- * returns instruction on success
- * 0 on error
+/* stdio engine
+ * the original engine, a thin wrapper around fread and fwrite
  */
-struct Instruction * parse_string(struct Instruction *i, char *source, size_t *index){
-    int len = 0;
 
-    /* check arguments */
-    if( ! i ){
-        puts("parse_string: null instruction");
-        return 0;
+int stdio_open(struct Program *p){
+    p->file = fopen(p->path, "r+b");
+    if( ! p->file ){
+        return 1;
     }
 
-    if( ! source ){
-        puts("parse_string: null source");
+    p->fd = fileno(p->file);
+    return 0;
+}
+
+void stdio_close(struct Program *p){
+    if( p->file ){
+        fclose(p->file);
+        p->file = 0;
+    }
+    p->fd = -1;
+}
+
+const char * stdio_view(struct Program *p, char *buf, size_t len, off_t offset, size_t *nr){
+    if( ! buf ){
+        /* 1 + len so callers may still treat buffer as a string */
+        buf = get_buffer(p, 1 + len);
+        if( ! buf ){
+            puts("stdio_view: call to get_buffer failed");
+            return 0;
+        }
+    }
+
+    if( fseeko(p->file, offset, SEEK_SET) ){
+        puts("stdio_view: fseeko failed");
         return 0;
     }
 
-    if( ! index ){
-        puts("parse_string: null index");
+    *nr = fread(buf, 1, len, p->file);
+    if( ferror(p->file) ){
+        puts("stdio_view: fread failed");
+        clearerr(p->file);
         return 0;
     }
 
+    return buf;
+}
+
+size_t stdio_write(struct Program *p, const char *buf, size_t len, off_t offset){
+    size_t nw = 0;
 
-    if( '/' != source[*index] ){
-        printf("Parse_string: unexpected character '%c', expected beginning delimiter'/'\n", source[*index]);
+    if( fseeko(p->file, offset, SEEK_SET) ){
+        puts("stdio_write: fseeko failed");
         return 0;
     }
 
-    /* skip past starting delimiter */
-    ++(*index);
-
-    /* save start of string */
-    i->argument.str = &(source[*index]);
+    nw = fwrite(buf, 1, len, p->file);
 
-    /* count length of string */
-    for( len=0; ; ++(*index) ){
-        switch( source[*index] ){
-            /* end of buffer */
-            case '\0':
-                /* error, expected terminating / */
-                puts("parse_string: unexpected end of source buffer, expected terminating delimiter'/'");
-                return 0;
-                break;
+    /* all changes are flushed immediately */
+    if( fflush(p->file) ){
+        puts("stdio_write: error flushing file");
+        return 0;
+    }
 
-            case '\\':
-                /* A bit yucky: Rework the string to delete the escape character '\'
-                 * Note the use of memmove as the source and destination overlap
-                 */
-                memmove(source+*index,
-                        source+*index+1,
-                        strlen(source+*index));
-                len++;
-                break;
+    return nw;
+}
 
-            /* terminating delimiter */
-            case '/':
-                /* skip past / */
-                ++(*index);
-                /* we are finished here */
-                goto EXIT;
-                break;
+int stdio_truncate(struct Program *p, off_t len){
+    /* truncate the file we have open, not whatever is now at p->path */
+    if( fflush(p->file) || ftruncate(p->fd, len) == -1 ){
+        perror("stdio_truncate: error in call to ftruncate");
+        return 1;
+    }
+    return 0;
+}
 
-            /* just another character in our string */
-            default:
-                ++len;
-                break;
-        }
+off_t stdio_size(struct Program *p){
+    if( fseeko(p->file, 0, SEEK_END) ){
+        puts("stdio_size: fseeko failed");
+        return -1;
     }
+    return ftello(p->file);
+}
 
-EXIT:
+size_t stdio_copy(struct Program *p, int fd, off_t from, size_t len, off_t offset){
+    /* writes are flushed as they are made and views seek first,
+     * so the copy can go to the descriptor underneath
+     */
+    return copy_range(p, fd, from, len, offset);
+}
 
-    i->argument.num = len;
+void stdio_seek(struct Program *p, off_t offset){
+    /* nothing to do as every access names its offset */
+}
 
-    return i;
+void stdio_fetch(struct Program *p, off_t offset, size_t len){
+    /* only a hint so failure is of no consequence */
+    posix_fadvise(p->fd, offset, len, POSIX_FADV_WILLNEED);
 }
 
-/* parsing helper method for parsing a number argument to a command
- * used for byte bnumber
- *
- * returns instruction on success
- * 0 on error
+int stdio_flush(struct Program *p){
+    /* every write is flushed as it is made */
+    return 0;
+}
+
+const struct Engine stdio_engine = {
+    "stdio",
+    stdio_open,
+    stdio_close,
+    stdio_view,
+    stdio_write,
+    stdio_copy,
+    stdio_truncate,
+    stdio_size,
+    stdio_seek,
+    stdio_fetch,
+    stdio_flush
+};
+
+/* pread engine
+ * positional reads and writes on a file descriptor,
+ * one system call per access with no seeking and no stdio buffering
  */
-struct Instruction * parse_number(struct Instruction *i, char *source, size_t *index){
-    char *endptr = 0;
 
-    /* check arguments */
-    if( ! i ){
-        puts("parse_number: null instruction");
-        return 0;
+int pread_open(struct Program *p){
+    p->fd = open(p->path, O_RDWR);
+    if( p->fd == -1 ){
+        return 1;
     }
 
-    if( ! source ){
-        puts("parse_number: null source");
-        return 0;
-    }
+    return 0;
+}
 
-    if( ! index ){
-        puts("parse_number: null index");
-        return 0;
+void pread_close(struct Program *p){
+    if( p->fd != -1 ){
+        close(p->fd);
+        p->fd = -1;
     }
-    /* read in number
-     * `0` as base for `automatic` base selection
-     */
-    i->argument.num = strtol(&(source[*index]), &endptr, 0);
+}
 
-    /* advance past number ourselves to check strtol consumed whole number
-     *
-     * strtol supports
-     *  <decimal number>
-     *  0<octal number>
-     *  0x<hexadecimal number>
-     *
-     * first skip past any leading 0 or 0x
-     * then find where we think the number should end
-     * finally compare that to where strtol stopped.
-     */
-    if( source[*index] == '0' ){
-        ++(*index);
-        if( source[*index] == 'x' ){
-            ++(*index);
+const char * pread_view(struct Program *p, char *buf, size_t len, off_t offset, size_t *nr){
+    ssize_t ret = 0;
+
+    if( ! buf ){
+        /* 1 + len so callers may still treat buffer as a string */
+        buf = get_buffer(p, 1 + len);
+        if( ! buf ){
+            puts("pread_view: call to get_buffer failed");
+            return 0;
         }
     }
 
-    for( ; ; ++(*index) ){
-        switch( source[*index] ){
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-                break;
-
-            default:
-                goto EXIT;
-                break;
+    /* pread may return short, keep going until len or EOF */
+    for( *nr = 0; *nr < len; *nr += ret ){
+        ret = pread(p->fd, buf + *nr, len - *nr, offset + *nr);
+        if( ret == -1 && errno == EINTR ){
+            ret = 0;
+            continue;
+        }
+        if( ret == -1 ){
+            perror("pread_view: error in call to pread");
+            return 0;
+        }
+        if( ret == 0 ){
+            break;
         }
     }
 
-EXIT:
+    return buf;
+}
 
-    if( endptr != &(source[*index]) ){
-        puts("parse_number: error when reading in number");
-        return 0;
+size_t pread_write(struct Program *p, const char *buf, size_t len, off_t offset){
+    ssize_t ret = 0;
+    size_t nw = 0;
+
+    for( nw = 0; nw < len; nw += ret ){
+        ret = pwrite(p->fd, buf + nw, len - nw, offset + nw);
+        if( ret == -1 && errno == EINTR ){
+            ret = 0;
+            continue;
+        }
+        if( ret == -1 ){
+            perror("pread_write: error in call to pwrite");
+            break;
+        }
     }
 
-    return i;
+    return nw;
 }
 
-struct Instruction * parse_print(char *source, size_t *index){
-    struct Instruction *ret = 0;
-    struct Instruction *i = 0;
-
-    i = new_instruction(PRINT);
-    if( ! i ){
-        puts("parse_print: call to new_instruction failed");
-        return 0;
+int pread_truncate(struct Program *p, off_t len){
+    if( ftruncate(p->fd, len) == -1 ){
+        perror("pread_truncate: error in call to ftruncate");
+        return 1;
     }
+    return 0;
+}
 
-    /* w/string/ */
-    switch( source[*index] ){
-        case 'p':
-        case 'P':
-            ++(*index);
-            break;
+off_t pread_size(struct Program *p){
+    struct stat st;
 
-        default:
-            printf("parse_print: unexpected character '%c', expected 'w'\n", source[*index]);
-            free(i);
-            return 0;
-            break;
+    if( fstat(p->fd, &st) ){
+        perror("pread_size: error in call to fstat");
+        return -1;
     }
 
-    /* print has 2 different forms
-     *  p127
-     *  p
-     * if next character is a number then we are in the first form
-     */
-    if( isdigit(source[*index]) ){
-        ret = parse_number(i, source, index);
-        if( ret == 0 ){
-            free(i);
-        }
-        return ret;
-    }
+    return st.st_size;
+}
 
-    /* otherwise there is no number and we are in second form (default to 100 bytes) */
-    return i;
+size_t pread_copy(struct Program *p, int fd, off_t from, size_t len, off_t offset){
+    return copy_range(p, fd, from, len, offset);
 }
 
-struct Instruction * parse_byte(char *source, size_t *index){
-    struct Instruction *ret = 0;
-    struct Instruction *i = 0;
+void pread_seek(struct Program *p, off_t offset){
+    /* nothing to do as every access names its offset */
+}
 
-    i = new_instruction(BYTE);
-    if( ! i ){
-        puts("parse_byte: call to new_instruction failed");
-        return 0;
-    }
+void pread_fetch(struct Program *p, off_t offset, size_t len){
+    /* only a hint so failure is of no consequence */
+    posix_fadvise(p->fd, offset, len, POSIX_FADV_WILLNEED);
+}
 
-    /* bn where n is positive integer */
-    switch( source[*index] ){
-        case 'b':
-        case 'B':
-            ++(*index);
-            break;
-        default:
-            printf("parse_byte: unexpected character '%c', expected 'b'\n", source[*index]);
-            free(i);
-            return 0;
-            break;
-    }
+int pread_flush(struct Program *p){
+    /* every write is made before pwrite returns */
+    return 0;
+}
 
-    ret = parse_number(i, source, index);
-    if( ret == 0 ){
-        free(i);
-    }
+const struct Engine pread_engine = {
+    "pread",
+    pread_open,
+    pread_close,
+    pread_view,
+    pread_write,
+    pread_copy,
+    pread_truncate,
+    pread_size,
+    pread_seek,
+    pread_fetch,
+    pread_flush
+};
 
-    return ret;
-}
+/* mmap engine
+ * the whole file is mapped shared, reads are served straight from the mapping
+ * and writes are copied into it
+ * the mapping is replaced whenever the file changes length
+ */
 
-struct Instruction * parse_line(char *source, size_t *index){
-    struct Instruction *ret = 0;
-    struct Instruction *i = 0;
+/* bytes ahead of cursor the kernel is told we will need */
+#define MAP_WILLNEED (1 << 20)
 
-    i = new_instruction(LINE);
-    if( ! i ){
-        puts("parse_line: call to new_instruction failed");
+/* (re)map file at its current length
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int map_remap(struct Program *p){
+    struct stat st;
+    void *map = 0;
+
+    if( p->map ){
+        munmap(p->map, p->map_len);
+        p->map = 0;
+        p->map_len = 0;
+    }
+
+    if( fstat(p->fd, &st) ){
+        perror("map_remap: error in call to fstat");
+        return 1;
+    }
+
+    /* empty files cannot be mapped, they have nothing to view anyway */
+    if( ! st.st_size ){
         return 0;
     }
 
-    /* ln where n is positive integer */
-    switch( source[*index] ){
-        case 'l':
-        case 'L':
-            ++(*index);
-            break;
-        default:
-            printf("parse_line: unexpected character '%c', expected 'l'\n", source[*index]);
-            free(i);
-            return 0;
-            break;
+    map = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, 0);
+    if( map == MAP_FAILED ){
+        perror("map_remap: error in call to mmap");
+        return 1;
     }
 
-    ret = parse_number(i, source, index);
+    p->map = map;
+    p->map_len = st.st_size;
 
-    if( i->argument.num == 0 ){
-        puts("parse_line: line number must be > 0\n");
-        ret = 0;
+    return 0;
+}
+
+int map_open(struct Program *p){
+    p->fd = open(p->path, O_RDWR);
+    if( p->fd == -1 ){
+        return 1;
     }
 
-    if( ret == 0 ){
-        free(i);
+    if( map_remap(p) ){
+        close(p->fd);
+        p->fd = -1;
+        return 1;
     }
 
-    return ret;
+    return 0;
 }
 
-struct Instruction * parse_expect(char *source, size_t *index){
-    struct Instruction *ret = 0;
-    struct Instruction *i = 0;
+void map_close(struct Program *p){
+    if( p->map ){
+        munmap(p->map, p->map_len);
+        p->map = 0;
+        p->map_len = 0;
+    }
 
-    i = new_instruction(EXPECT);
-    if( ! i ){
-        puts("parse_expect: call to new_instruction failed");
-        return 0;
+    if( p->fd != -1 ){
+        close(p->fd);
+        p->fd = -1;
     }
+}
 
-    /* e/string/ */
-    switch( source[*index] ){
-        case 'e':
-        case 'E':
-            ++(*index);
-            break;
+const char * map_view(struct Program *p, char *buf, size_t len, off_t offset, size_t *nr){
+    if( offset >= p->map_len ){
+        *nr = 0;
+        /* any non-null pointer will do for an empty view */
+        return p->map ? p->map : buf ? buf : "";
+    }
 
-        default:
-            printf("parse_expect: unexpected character '%c', expected 'e'\n", source[*index]);
-            free(i);
+    *nr = len < p->map_len - offset ? len : p->map_len - offset;
+    return p->map + offset;
+}
+
+size_t map_write(struct Program *p, const char *buf, size_t len, off_t offset){
+    /* grow file to fit write */
+    if( offset + len > p->map_len ){
+        if( ftruncate(p->fd, offset + len) == -1 ){
+            perror("map_write: error in call to ftruncate");
             return 0;
-            break;
+        }
+        if( map_remap(p) ){
+            return 0;
+        }
     }
 
-    ret = parse_string(i, source, index);
-    if( ret == 0 ){
-        free(i);
-    }
+    memcpy(p->map + offset, buf, len);
 
-    return ret;
+    return len;
 }
 
-struct Instruction * parse_write(char *source, size_t *index){
-    struct Instruction *ret = 0;
-    struct Instruction *i = 0;
+size_t map_copy(struct Program *p, int fd, off_t from, size_t len, off_t offset){
+    size_t nw = 0;
 
-    i = new_instruction(WRITE);
-    if( ! i ){
-        puts("parse_write: call to new_instruction failed");
+    /* the shared mapping sees the copy, but not the file growing */
+    nw = copy_range(p, fd, from, len, offset);
+    if( offset + nw > p->map_len && map_remap(p) ){
         return 0;
     }
 
-    /* w/string/ */
-    switch( source[*index] ){
-        case 'w':
-        case 'W':
-            ++(*index);
-            break;
+    return nw;
+}
 
-        default:
-            printf("parse_write: unexpected character '%c', expected 'w'\n", source[*index]);
-            free(i);
-            return 0;
-            break;
-    }
-    ret = parse_string(i, source, index);
-    if( ret == 0 ){
-        free(i);
+int map_truncate(struct Program *p, off_t len){
+    if( ftruncate(p->fd, len) == -1 ){
+        perror("map_truncate: error in call to ftruncate");
+        return 1;
     }
 
-    return ret;
+    return map_remap(p);
 }
 
-struct Instruction * parse_truncate(char *source, size_t *index){
-    struct Instruction *i = 0;
+off_t map_size(struct Program *p){
+    return p->map_len;
+}
 
-    switch( source[*index] ){
-        case 't':
-        case 'T':
-            /* advance past letter */
-            ++(*index);
-            break;
+void map_seek(struct Program *p, off_t offset){
+    /* page containing cursor onwards */
+    off_t start = offset - offset % sysconf(_SC_PAGESIZE);
 
-        default:
-            printf("Parse_truncate: unexpected character '%c', expected 't'\n", source[*index]);
-            return 0;
+    if( start >= p->map_len ){
+        return;
     }
 
+    /* only a hint so failure is of no consequence */
+    posix_madvise(p->map + start,
+                  p->map_len - start < MAP_WILLNEED ? p->map_len - start : MAP_WILLNEED,
+                  POSIX_MADV_WILLNEED);
+}
 
-    i = new_instruction(TRUNCATE);
-    if( ! i ){
-        puts("Parse_truncate: call to new_instruction failed");
-        return 0;
+void map_fetch(struct Program *p, off_t offset, size_t len){
+    /* page containing offset onwards */
+    off_t start = offset - offset % sysconf(_SC_PAGESIZE);
+
+    if( start >= p->map_len ){
+        return;
     }
 
-    return i;
+    if( offset + (off_t)len > p->map_len ){
+        len = p->map_len - offset;
+    }
+
+    /* only a hint so failure is of no consequence */
+    posix_madvise(p->map + start, offset + len - start, POSIX_MADV_WILLNEED);
 }
 
-struct Instruction * parse_quit(char *source, size_t *index){
-    struct Instruction *i = 0;
+int map_flush(struct Program *p){
+    /* writes are copies into the mapping, the kernel writes them back */
+    return 0;
+}
 
-    switch( source[*index] ){
-        case 'q':
-        case 'Q':
-            /* advance past letter */
-            ++(*index);
-        case '\0': /* treat \0 as implicit quit */
-            break;
+const struct Engine map_engine = {
+    "mmap",
+    map_open,
+    map_close,
+    map_view,
+    map_write,
+    map_copy,
+    map_truncate,
+    map_size,
+    map_seek,
+    map_fetch,
+    map_flush
+};
 
-        default:
-            printf("parse_quit: unexpected character '%c'\n", source[*index]);
-            return 0;
-    }
+/* io_uring engine
+ * the pread engine with reads and writes queued on an io_uring, many at once:
+ * bytes fetched ahead of the commands needing them are read into slots
+ * which views are then served from, and writes are queued without waiting,
+ * so a run of scattered reads or writes keeps the device busy with all of them
+ * writes are waited for by flush, and before anything that could see the file
+ * as they leave it other than a view of bytes none of them touch
+ * where the kernel lacks io_uring the file is opened with the pread engine instead
+ */
 
+#ifdef __linux__
 
-    i = new_instruction(QUIT);
-    if( ! i ){
-        puts("parse_quit: call to new_instruction failed");
-        return 0;
-    }
+/* most reads and writes under way at once */
+#define URING_DEPTH 64
+/* largest fetch read into a slot, larger ones are left to the kernel's readahead */
+#define URING_FETCH_MAX (256 << 10)
 
-    return i;
+/* a read or write under way, or a read done and waiting to be viewed */
+struct UringSlot {
+    char *buf;
+    size_t cap;
+    /* range of file read or written */
+    off_t offset;
+    size_t len;
+    /* bytes read, or -errno, once done */
+    long long int res;
+    /* URING_FREE, URING_READ or URING_WRITE */
+    int kind;
+    /* submitted and not yet reaped */
+    int busy;
+    /* read overtaken by a write to its bytes, its result is thrown away */
+    int stale;
+    /* order slot was filled in, to reuse the oldest */
+    unsigned long long int seq;
+};
+
+enum { URING_FREE, URING_READ, URING_WRITE };
+
+struct Uring {
+    int fd;
+    /* submission ring, its length, and its entries */
+    char *sq_ring;
+    size_t sq_ring_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    /* completion ring, which may share the submission ring's mapping */
+    char *cq_ring;
+    size_t cq_ring_len;
+    struct io_uring_cqe *cqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    /* entries filled in but not yet submitted */
+    unsigned queued;
+    struct UringSlot slots[URING_DEPTH];
+    unsigned long long int seq;
+    /* a queued write failed since the last flush */
+    int failed;
+};
+
+/* release everything uring_setup acquired */
+void uring_free(struct Uring *u){
+    size_t k = 0;
+
+    if( u->sqes ){
+        munmap(u->sqes, u->sqes_len);
+    }
+    if( u->cq_ring && u->cq_ring != u->sq_ring ){
+        munmap(u->cq_ring, u->cq_ring_len);
+    }
+    if( u->sq_ring ){
+        munmap(u->sq_ring, u->sq_ring_len);
+    }
+    if( u->fd != -1 ){
+        close(u->fd);
+    }
+    for( k = 0; k < URING_DEPTH; ++k ){
+        free(u->slots[k].buf);
+    }
+    free(u);
 }
 
-/* consume comment from source
- * return 0 on success
- * return 1 on error
+/* set up a ring of URING_DEPTH entries, after probing that the kernel has one
+ * and can read and write through it
+ * returns ring on success
+ * returns 0 if io_uring cannot be used
  */
-int parse_comment(char *source, size_t *index){
+struct Uring * uring_setup(void){
+    struct io_uring_params params;
+    struct io_uring_probe *probe = 0;
+    struct Uring *u = 0;
+    size_t probe_len = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+    int supported = 0;
+
+    u = calloc(1, sizeof(*u));
+    probe = calloc(1, probe_len);
+    if( ! u || ! probe ){
+        goto FAIL;
+    }
 
-    if( source[*index] != '#' ){
-        printf("parse_comment: expected '#', got '%c'\n", source[*index]);
-        return 1;
+    memset(&params, 0, sizeof(params));
+    u->fd = syscall(__NR_io_uring_setup, URING_DEPTH, &params);
+    if( u->fd == -1 ){
+        goto FAIL;
     }
 
-    /* consume source until \n or \0 are found */
-    while( 1 ){
-        switch( source[*index] ){
+    if( syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PROBE, probe, 256) == -1 ){
+        goto FAIL;
+    }
+    supported =    probe->ops_len > IORING_OP_WRITE
+                && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+                && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+    if( ! supported ){
+        goto FAIL;
+    }
 
-            case '\n':
-            case '\0':
-                /* end comment
-                 * leave character for parent to look at
-                 */
-                goto EXIT;
-                break;
+    u->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if( params.features & IORING_FEAT_SINGLE_MMAP && u->cq_ring_len > u->sq_ring_len ){
+        u->sq_ring_len = u->cq_ring_len;
+    }
 
-            default:
-                ++(*index);
-                break;
+    u->sq_ring = mmap(0, u->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if( u->sq_ring == MAP_FAILED ){
+        u->sq_ring = 0;
+        goto FAIL;
+    }
 
+    if( params.features & IORING_FEAT_SINGLE_MMAP ){
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(0, u->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if( u->cq_ring == MAP_FAILED ){
+            u->cq_ring = 0;
+            goto FAIL;
         }
     }
 
-EXIT:
+    u->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(0, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if( u->sqes == MAP_FAILED ){
+        u->sqes = 0;
+        goto FAIL;
+    }
 
+    u->sq_head = (unsigned *)(u->sq_ring + params.sq_off.head);
+    u->sq_tail = (unsigned *)(u->sq_ring + params.sq_off.tail);
+    u->sq_mask = (unsigned *)(u->sq_ring + params.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(u->sq_ring + params.sq_off.array);
+    u->cq_head = (unsigned *)(u->cq_ring + params.cq_off.head);
+    u->cq_tail = (unsigned *)(u->cq_ring + params.cq_off.tail);
+    u->cq_mask = (unsigned *)(u->cq_ring + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(u->cq_ring + params.cq_off.cqes);
+
+    free(probe);
+    return u;
+
+FAIL:
+    free(probe);
+    if( u ){
+        uring_free(u);
+    }
     return 0;
 }
 
-/* parse provided source into Program
- * return 0 on success
- * return 1 on failure
+/* fill in the next submission entry for slot k
+ * there is always room as each slot has at most one entry
+ */
+void uring_queue(struct Program *p, size_t k){
+    struct Uring *u = p->uring;
+    struct UringSlot *slot = &(u->slots[k]);
+    unsigned tail = *u->sq_tail;
+    unsigned index = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &(u->sqes[index]);
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = slot->kind == URING_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = p->fd;
+    sqe->off = slot->offset;
+    sqe->addr = (unsigned long)slot->buf;
+    sqe->len = slot->len;
+    sqe->user_data = k;
+
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    slot->busy = 1;
+    slot->res = 0;
+    ++u->queued;
+}
+
+/* finish with every completion the kernel has posted
+ * a write done short is finished with pwrite, one that failed is remembered for flush
+ */
+void uring_reap(struct Program *p){
+    struct Uring *u = p->uring;
+    struct UringSlot *slot = 0;
+    struct io_uring_cqe *cqe = 0;
+    unsigned head = *u->cq_head;
+    size_t nw = 0;
+
+    for( ; head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE); ++head ){
+        cqe = &(u->cqes[head & *u->cq_mask]);
+        slot = &(u->slots[cqe->user_data]);
+        slot->busy = 0;
+        slot->res = cqe->res;
+
+        if( slot->kind == URING_WRITE ){
+            if( cqe->res < 0 ){
+                printf("uring_reap: write of '%zu' bytes at offset '%lld' failed: %s\n",
+                       slot->len, (long long int)slot->offset, strerror(-cqe->res));
+                u->failed = 1;
+            } else if( (size_t)cqe->res < slot->len ){
+                nw = pread_write(p, slot->buf + cqe->res, slot->len - cqe->res, slot->offset + cqe->res);
+                if( nw != slot->len - cqe->res ){
+                    u->failed = 1;
+                }
+            }
+            slot->kind = URING_FREE;
+        } else if( slot->stale ){
+            slot->kind = URING_FREE;
+        }
+    }
+
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* submit everything queued, then if wait wait until a completion is posted
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int uring_enter(struct Program *p, int wait){
+    struct Uring *u = p->uring;
+    long ret = 0;
+
+    while( u->queued || wait ){
+        ret = syscall(__NR_io_uring_enter, u->fd, u->queued, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+        if( ret == -1 && (errno == EINTR || errno == EAGAIN || errno == EBUSY) ){
+            uring_reap(p);
+            continue;
+        }
+        if( ret == -1 ){
+            perror("uring_enter: error in call to io_uring_enter");
+            return 1;
+        }
+        u->queued -= ret;
+        wait = 0;
+    }
+
+    uring_reap(p);
+    return 0;
+}
+
+/* wait until slot k is done
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int uring_wait(struct Program *p, size_t k){
+    while( p->uring->slots[k].busy ){
+        if( uring_enter(p, 1) ){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* wait until no write is under way, or if reads too nothing at all
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int uring_drain(struct Program *p, int reads){
+    struct UringSlot *slot = 0;
+    size_t k = 0;
+
+    for( k = 0; k < URING_DEPTH; ++k ){
+        slot = &(p->uring->slots[k]);
+        if( slot->busy && (reads || slot->kind == URING_WRITE) && uring_wait(p, k) ){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* number of a slot free to fill, reusing the oldest read if none are free
+ * returns URING_DEPTH if every slot is under way
+ */
+size_t uring_slot(struct Program *p){
+    struct UringSlot *slots = p->uring->slots;
+    size_t oldest = URING_DEPTH;
+    size_t k = 0;
+
+    for( k = 0; k < URING_DEPTH; ++k ){
+        if( slots[k].kind == URING_FREE ){
+            return k;
+        }
+        if( ! slots[k].busy && (oldest == URING_DEPTH || slots[k].seq < slots[oldest].seq) ){
+            oldest = k;
+        }
+    }
+
+    return oldest;
+}
+
+/* make slot k's buffer hold len bytes, and 1 more so views may be treated as strings
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int uring_grow(struct UringSlot *slot, size_t len){
+    char *buf = 0;
+
+    if( slot->cap < len + 1 ){
+        buf = realloc(slot->buf, len + 1);
+        if( ! buf ){
+            puts("uring_grow: call to realloc failed");
+            return 1;
+        }
+        slot->buf = buf;
+        slot->cap = len + 1;
+    }
+    return 0;
+}
+
+/* forget reads of any byte of [offset, offset + len) */
+void uring_forget(struct Program *p, off_t offset, off_t len){
+    struct UringSlot *slot = 0;
+    size_t k = 0;
+
+    for( k = 0; k < URING_DEPTH; ++k ){
+        slot = &(p->uring->slots[k]);
+        if(    slot->kind == URING_READ
+            && slot->offset < offset + len
+            && slot->offset + (off_t)slot->len > offset
+        ){
+            if( slot->busy ){
+                slot->stale = 1;
+            } else {
+                slot->kind = URING_FREE;
+            }
+        }
+    }
+}
+
+/* whether a write under way touches [offset, offset + len) */
+int uring_writing(struct Program *p, off_t offset, off_t len){
+    struct UringSlot *slot = 0;
+    size_t k = 0;
+
+    for( k = 0; k < URING_DEPTH; ++k ){
+        slot = &(p->uring->slots[k]);
+        if(    slot->kind == URING_WRITE
+            && slot->offset < offset + len
+            && slot->offset + (off_t)slot->len > offset
+        ){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int uring_open(struct Program *p){
+    if( pread_open(p) ){
+        return 1;
+    }
+
+    p->uring = uring_setup();
+    if( ! p->uring ){
+        /* no io_uring here, carry on as the pread engine */
+        p->engine = &pread_engine;
+    }
+
+    return 0;
+}
+
+int uring_flush(struct Program *p){
+    int failed = 0;
+
+    if( uring_enter(p, 0) || uring_drain(p, 0) ){
+        return 1;
+    }
+
+    failed = p->uring->failed;
+    p->uring->failed = 0;
+    return failed;
+}
+
+void uring_close(struct Program *p){
+    if( p->uring ){
+        /* reads too, the kernel may still be filling their buffers */
+        if( uring_flush(p) || uring_drain(p, 1) ){
+            puts("uring_close: failed to finish writes");
+        }
+        uring_free(p->uring);
+        p->uring = 0;
+    }
+    pread_close(p);
+}
+
+const char * uring_view(struct Program *p, char *buf, size_t len, off_t offset, size_t *nr){
+    struct UringSlot *slots = p->uring->slots;
+    size_t k = 0;
+    size_t j = 0;
+
+    for( k = 0; k < URING_DEPTH; ++k ){
+        if(    slots[k].kind == URING_READ && ! slots[k].stale
+            && slots[k].offset <= offset
+            && offset + (off_t)len <= slots[k].offset + (off_t)slots[k].len
+        ){
+            break;
+        }
+    }
+
+    if( k < URING_DEPTH ){
+        if( uring_wait(p, k) ){
+            return 0;
+        }
+
+        /* a short read may since have been overtaken by a write past the end */
+        if( slots[k].res == (long long int)slots[k].len ){
+            /* views come in program order, so every read before this one is done with */
+            for( j = 0; j < URING_DEPTH; ++j ){
+                if( slots[j].kind == URING_READ && ! slots[j].busy && slots[j].seq < slots[k].seq ){
+                    slots[j].kind = URING_FREE;
+                }
+            }
+            *nr = len;
+            return slots[k].buf + (offset - slots[k].offset);
+        }
+        slots[k].kind = URING_FREE;
+    }
+
+    if( uring_writing(p, offset, len) && (uring_enter(p, 0) || uring_drain(p, 0)) ){
+        return 0;
+    }
+
+    return pread_view(p, buf, len, offset, nr);
+}
+
+size_t uring_write(struct Program *p, const char *buf, size_t len, off_t offset){
+    struct Uring *u = p->uring;
+    struct UringSlot *slot = 0;
+    size_t k = 0;
+
+    if( ! len ){
+        return 0;
+    }
+
+    uring_forget(p, offset, len);
+
+    /* writes to the same bytes must land in order */
+    if( uring_writing(p, offset, len) && (uring_enter(p, 0) || uring_drain(p, 0)) ){
+        return 0;
+    }
+
+    if( len > BLOCK_SIZE ){
+        return pread_write(p, buf, len, offset);
+    }
+
+    for( k = uring_slot(p); k == URING_DEPTH; k = uring_slot(p) ){
+        if( uring_enter(p, 1) ){
+            return 0;
+        }
+    }
+
+    slot = &(u->slots[k]);
+    if( uring_grow(slot, len) ){
+        return 0;
+    }
+    memcpy(slot->buf, buf, len);
+    slot->kind = URING_WRITE;
+    slot->stale = 0;
+    slot->offset = offset;
+    slot->len = len;
+    slot->seq = u->seq++;
+    uring_queue(p, k);
+
+    /* a full ring goes to the kernel at once, otherwise it waits for the next view or flush */
+    if( u->queued == URING_DEPTH && uring_enter(p, 0) ){
+        return 0;
+    }
+
+    return len;
+}
+
+size_t uring_copy(struct Program *p, int fd, off_t from, size_t len, off_t offset){
+    if( uring_flush(p) ){
+        return 0;
+    }
+
+    uring_forget(p, offset, len);
+    return copy_range(p, fd, from, len, offset);
+}
+
+int uring_truncate(struct Program *p, off_t len){
+    off_t size = 0;
+
+    if( uring_flush(p) ){
+        return 1;
+    }
+
+    /* reads cut short by the old end of file are thrown away when viewed */
+    size = pread_size(p);
+    if( size > len ){
+        uring_forget(p, len, size - len);
+    }
+
+    return pread_truncate(p, len);
+}
+
+off_t uring_size(struct Program *p){
+    /* writes under way may extend the file */
+    if( uring_flush(p) ){
+        return -1;
+    }
+
+    return pread_size(p);
+}
+
+void uring_seek(struct Program *p, off_t offset){
+    /* nothing to do as every access names its offset */
+}
+
+void uring_fetch(struct Program *p, off_t offset, size_t len){
+    struct Uring *u = p->uring;
+    struct UringSlot *slot = 0;
+    size_t k = 0;
+
+    for( k = 0; k < URING_DEPTH; ++k ){
+        slot = &(u->slots[k]);
+        if(    slot->kind == URING_READ && ! slot->stale
+            && slot->offset <= offset
+            && offset + (off_t)len <= slot->offset + (off_t)slot->len
+        ){
+            return;
+        }
+    }
+
+    /* too large to hold, or would read bytes still being written, so only hint */
+    k = uring_slot(p);
+    if( ! len || len > URING_FETCH_MAX || uring_writing(p, offset, len) || k == URING_DEPTH ){
+        pread_fetch(p, offset, len);
+        return;
+    }
+
+    slot = &(u->slots[k]);
+    if( uring_grow(slot, len) ){
+        return;
+    }
+    slot->kind = URING_READ;
+    slot->stale = 0;
+    slot->offset = offset;
+    slot->len = len;
+    slot->seq = u->seq++;
+    uring_queue(p, k);
+
+    if( u->queued == URING_DEPTH ){
+        uring_enter(p, 0);
+    }
+}
+
+const struct Engine uring_engine = {
+    "io_uring",
+    uring_open,
+    uring_close,
+    uring_view,
+    uring_write,
+    uring_copy,
+    uring_truncate,
+    uring_size,
+    uring_seek,
+    uring_fetch,
+    uring_flush
+};
+
+#else
+
+/* no io_uring off linux, the pread engine stands in */
+#define uring_engine pread_engine
+
+#endif
+
+/* direct engine
+ * the pread engine with the file opened O_DIRECT, so its bytes never enter the page cache
+ * and scanning a large file leaves the pages of everything else on the host where they are
+ * reads and writes go through p->aligned, widened to DIRECT_ALIGN bounds,
+ * writes reading in the blocks they only partly cover first
+ * where the file system refuses O_DIRECT the file is opened with the pread engine instead
+ */
+
+#ifdef O_DIRECT
+
+/* return p->aligned, grown to hold len bytes
+ * returns 0 on error
+ */
+char * direct_buffer(struct Program *p, size_t len){
+    void *aligned = 0;
+
+    if( p->aligned_len >= len ){
+        return p->aligned;
+    }
+
+    if( posix_memalign(&aligned, DIRECT_ALIGN, len) ){
+        puts("direct_buffer: failed to allocate buffer");
+        return 0;
+    }
+
+    free(p->aligned);
+    p->aligned = aligned;
+    p->aligned_len = len;
+    return p->aligned;
+}
+
+int direct_open(struct Program *p){
+    p->fd = open(p->path, O_RDWR | O_DIRECT);
+    if( p->fd == -1 && errno == EINVAL ){
+        /* no O_DIRECT on this file system, carry on as the pread engine */
+        p->engine = &pread_engine;
+        return pread_open(p);
+    }
+    if( p->fd == -1 ){
+        return 1;
+    }
+
+    p->direct = 1;
+    return 0;
+}
+
+void direct_close(struct Program *p){
+    pread_close(p);
+    free(p->aligned);
+    p->aligned = 0;
+    p->aligned_len = 0;
+    p->direct = 0;
+}
+
+const char * direct_view(struct Program *p, char *buf, size_t len, off_t offset, size_t *nr){
+    /* aligned bounds of the read, and room for callers to treat it as a string */
+    char *aligned = direct_buffer(p, len + 2 * DIRECT_ALIGN + 1);
+    ssize_t ret = 0;
+
+    if( ! aligned ){
+        return 0;
+    }
+
+    ret = pread_aligned(p->fd, aligned, len, offset);
+    if( ret == -1 ){
+        perror("direct_view: error in call to pread");
+        return 0;
+    }
+    *nr = ret;
+
+    /* views into buf must outlast the next view into p->aligned */
+    if( buf ){
+        memcpy(buf, aligned, *nr);
+        return buf;
+    }
+
+    return aligned;
+}
+
+/* read the block at start into buf, filling any of it past the end of the file with zeros
+ * returns number of bytes of the file it holds
+ * returns -1 on failure
+ */
+ssize_t direct_block(struct Program *p, char *buf, off_t start){
+    ssize_t ret = pread_aligned(p->fd, buf, DIRECT_ALIGN, start);
+
+    if( ret == -1 ){
+        perror("direct_block: error in call to pread");
+        return -1;
+    }
+
+    memset(buf + ret, 0, DIRECT_ALIGN - ret);
+    return ret;
+}
+
+size_t direct_write(struct Program *p, const char *buf, size_t len, off_t offset){
+    off_t start = offset - offset % DIRECT_ALIGN;
+    size_t skip = offset - start;
+    size_t total = (skip + len + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+    /* start of the last block, and how much of it the file held */
+    off_t tail = start + (off_t)total - DIRECT_ALIGN;
+    ssize_t held = DIRECT_ALIGN;
+    char *aligned = 0;
+    ssize_t ret = 0;
+    size_t nw = 0;
+
+    if( ! len ){
+        return 0;
+    }
+
+    aligned = direct_buffer(p, total);
+    if( ! aligned ){
+        return 0;
+    }
+
+    /* blocks the write only partly covers keep the rest of their bytes */
+    if( skip && direct_block(p, aligned, start) == -1 ){
+        return 0;
+    }
+    if( (skip + len) % DIRECT_ALIGN ){
+        held = direct_block(p, aligned + total - DIRECT_ALIGN, tail);
+        if( held == -1 ){
+            return 0;
+        }
+    }
+    memcpy(aligned + skip, buf, len);
+
+    for( nw = 0; nw < total; nw += ret ){
+        ret = pwrite(p->fd, aligned + nw, total - nw, start + nw);
+        if( ret == -1 && errno == EINTR ){
+            ret = 0;
+            continue;
+        }
+        if( ret == -1 ){
+            perror("direct_write: error in call to pwrite");
+            return 0;
+        }
+    }
+
+    /* the whole last block was written, though the file may have ended within it */
+    if(    held < DIRECT_ALIGN
+        && ftruncate(p->fd, tail + held > offset + (off_t)len ? tail + held : offset + (off_t)len) == -1
+    ){
+        perror("direct_write: error in call to ftruncate");
+        return 0;
+    }
+
+    return len;
+}
+
+size_t direct_copy(struct Program *p, int fd, off_t from, size_t len, off_t offset){
+    /* the kernel would copy through the page cache, so read and write it here */
+    char *block = get_block(p);
+    size_t want = 0;
+    size_t nw = 0;
+    ssize_t ret = 0;
+
+    if( ! block ){
+        return 0;
+    }
+
+    for( nw = 0; nw < len; nw += ret ){
+        want = len - nw < BLOCK_SIZE ? len - nw : BLOCK_SIZE;
+        ret = pread(fd, block, want, from + nw);
+        if( ret == -1 && errno == EINTR ){
+            ret = 0;
+            continue;
+        }
+        if( ret <= 0 ){
+            break;
+        }
+        if( direct_write(p, block, ret, offset + nw) != (size_t)ret ){
+            break;
+        }
+    }
+
+    return nw;
+}
+
+void direct_fetch(struct Program *p, off_t offset, size_t len){
+    /* reads bypass the page cache, so there is nothing for the kernel to read ahead into */
+}
+
+const struct Engine direct_engine = {
+    "direct",
+    direct_open,
+    direct_close,
+    direct_view,
+    direct_write,
+    direct_copy,
+    pread_truncate,
+    pread_size,
+    pread_seek,
+    direct_fetch,
+    pread_flush
+};
+
+#else
+
+/* no O_DIRECT here, the pread engine stands in */
+#define direct_engine pread_engine
+
+#endif
+
+
+/***** line index *****/
+
+/* append a checkpoint to index
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int index_push(struct Index *idx, off_t offset){
+    off_t *checkpoints = 0;
+    size_t cap = 0;
+
+    if( idx->len == idx->cap ){
+        cap = idx->cap ? 2 * idx->cap : 64;
+        checkpoints = realloc(idx->checkpoints, cap * sizeof(off_t));
+        if( ! checkpoints ){
+            puts("index_push: failed to grow checkpoints");
+            return 1;
+        }
+        idx->checkpoints = checkpoints;
+        idx->cap = cap;
+    }
+
+    idx->checkpoints[idx->len++] = offset;
+    idx->dirty = 1;
+
+    return 0;
+}
+
+/* forget all checkpoints beyond offset
+ * used when the newlines after offset may have changed
+ */
+void index_invalidate(struct Index *idx, off_t offset){
+    /* checkpoints[0] is always valid */
+    while( idx->len > 1 && idx->checkpoints[idx->len - 1] > offset ){
+        --idx->len;
+    }
+
+    /* file has changed so header on disk is stale regardless */
+    idx->dirty = 1;
+}
+
+/* load sidecar index into idx if it matches st
+ * returns 0 if index was loaded
+ * returns 1 if there was no usable index
+ */
+int index_load(struct Index *idx, struct stat *st){
+    struct IndexHeader header;
+    FILE *file = 0;
+    int ret = 1;
+
+    file = fopen(idx->path, "rb");
+    if( ! file ){
+        return 1;
+    }
+
+    if( 1 != fread(&header, sizeof(header), 1, file) ){
+        goto EXIT;
+    }
+
+    if(    strncmp(header.magic, INDEX_MAGIC, sizeof(header.magic))
+        || header.version != INDEX_VERSION
+        || header.interval != INDEX_INTERVAL
+        || header.dev != st->st_dev
+        || header.ino != st->st_ino
+        || header.size != st->st_size
+        || header.mtime_sec != st->st_mtim.tv_sec
+        || header.mtime_nsec != st->st_mtim.tv_nsec
+        || header.len < 1
+    ){
+        goto EXIT;
+    }
+
+    idx->checkpoints = malloc(header.len * sizeof(off_t));
+    if( ! idx->checkpoints ){
+        goto EXIT;
+    }
+    idx->cap = header.len;
+
+    if( header.len != fread(idx->checkpoints, sizeof(off_t), header.len, file) ){
+        goto EXIT;
+    }
+    idx->len = header.len;
+
+    ret = 0;
+
+EXIT:
+    if( ret ){
+        /* partial loads are discarded */
+        idx->len = 0;
+    }
+    fclose(file);
+    return ret;
+}
+
+/* open line index for program file
+ * the sidecar index is loaded if it is still valid for the file,
+ * otherwise a fresh index is started
+ *
+ * returns index on success
+ * returns 0 on error
+ */
+struct Index * index_open(struct Program *p){
+    struct Index *idx = 0;
+    struct stat st;
+
+    if( fstat(p->fd, &st) ){
+        perror("index_open: error in call to fstat");
+        return 0;
+    }
+
+    idx = calloc(1, sizeof(struct Index));
+    if( ! idx ){
+        puts("index_open: call to calloc failed");
+        return 0;
+    }
+
+    idx->path = malloc(strlen(p->path) + sizeof(INDEX_SUFFIX));
+    if( ! idx->path ){
+        puts("index_open: call to malloc failed");
+        free(idx);
+        return 0;
+    }
+    strcpy(idx->path, p->path);
+    strcat(idx->path, INDEX_SUFFIX);
+
+    if( index_load(idx, &st) ){
+        /* start fresh with only line 1 known */
+        if( index_push(idx, 0) ){
+            free(idx->checkpoints);
+            free(idx->path);
+            free(idx);
+            return 0;
+        }
+    }
+
+    return idx;
+}
+
+/* write index out to its sidecar if it has changed
+ * the identity of the file is taken at the time of saving,
+ * so all writes to the file must have been made
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int index_save(struct Program *p){
+    struct Index *idx = p->index;
+    struct IndexHeader header;
+    struct stat st;
+    FILE *file = 0;
+    int ret = 0;
+
+    if( ! idx->dirty ){
+        return 0;
+    }
+
+    if( fstat(p->fd, &st) ){
+        perror("index_save: unable to stat file");
+        return 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.interval = INDEX_INTERVAL;
+    header.dev = st.st_dev;
+    header.ino = st.st_ino;
+    header.size = st.st_size;
+    header.mtime_sec = st.st_mtim.tv_sec;
+    header.mtime_nsec = st.st_mtim.tv_nsec;
+    header.len = idx->len;
+
+    file = fopen(idx->path, "wb");
+    if( ! file ){
+        printf("index_save: failed to open index '%s'\n", idx->path);
+        return 1;
+    }
+
+    if(    1 != fwrite(&header, sizeof(header), 1, file)
+        || idx->len != fwrite(idx->checkpoints, sizeof(off_t), idx->len, file)
+    ){
+        printf("index_save: failed to write index '%s'\n", idx->path);
+        ret = 1;
+    }
+
+    if( fclose(file) ){
+        printf("index_save: failed to close index '%s'\n", idx->path);
+        ret = 1;
+    }
+
+    if( ! ret ){
+        idx->dirty = 0;
+    }
+
+    return ret;
+}
+
+/* update line index ahead of writing len bytes of str at offset
+ * checkpoints beyond offset only survive if the write
+ * leaves every newline where it was
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int index_write(struct Program *p, const char *str, size_t len, off_t offset){
+    struct Index *idx = p->index;
+    const char *buf = 0;
+    size_t nr = 0;
+    size_t i = 0;
+
+    idx->dirty = 1;
+
+    /* no checkpoints after offset, nothing to lose */
+    if( ! len || idx->checkpoints[idx->len - 1] <= offset ){
+        return 0;
+    }
+
+    /* view bytes about to be overwritten */
+    buf = p->engine->view(p, 0, len, offset, &nr);
+    if( ! buf ){
+        puts("index_write: failed to read file");
+        return 1;
+    }
+
+    for( i = 0; i < len; ++i ){
+        /* bytes past end of file read as not being newlines */
+        if( (str[i] == '\n') != (i < nr && buf[i] == '\n') ){
+            index_invalidate(idx, offset);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void index_free(struct Index *idx){
+    free(idx->checkpoints);
+    free(idx->path);
+    free(idx);
+}
+
+
+/***** pending edits *****/
+
+/* length of file once pending edits are applied
+ * returns -1 on failure
+ */
+off_t edit_size(struct Program *p){
+    off_t size = p->engine->size(p);
+
+    return size == -1 ? -1 : size + p->pending.delta;
+}
+
+/* replace n bytes at offset at of the file as edited so far with len bytes of str
+ * [at, at + n) must lie within the edited file
+ *
+ * every edit the replaced range touches is merged into one,
+ * so edits stay sorted and apart however they arrive
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int edit_splice(struct Program *p, off_t at, off_t n, const char *str, size_t len){
+    struct Pending *pending = &(p->pending);
+    struct Edit *edits = pending->edits;
+    struct Edit *first = 0;
+    struct Edit *last = 0;
+    struct Edit merged;
+    char *grown = 0;
+    /* change in length from edits before a, and before b */
+    off_t delta = 0;
+    off_t after = 0;
+    /* where str of first and last start in the edited file */
+    off_t start = 0;
+    off_t end = 0;
+    /* bytes of first and last str which survive the splice */
+    size_t head = 0;
+    size_t tail = 0;
+    /* edits a to b - 1 touch [at, at + n] */
+    size_t a = 0;
+    size_t b = 0;
+    size_t k = 0;
+
+    if( ! n && ! len ){
+        return 0;
+    }
+
+    /* edits usually arrive in order, in which case all of them come before at */
+    last = pending->len ? &(edits[pending->len - 1]) : 0;
+
+    /* running on from the end of the last edit, as adjacent writes and
+     * inserts do, grows its str rather than copying it into a new one
+     */
+    if( last && at == last->offset + last->remove + pending->delta ){
+        if( len ){
+            grown = realloc(last->str, last->len + len);
+            if( ! grown ){
+                puts("edit_splice: call to realloc failed");
+                return 1;
+            }
+            memcpy(grown + last->len, str, len);
+            last->str = grown;
+            last->len += len;
+        }
+        last->remove += n;
+        pending->delta += (off_t)len - n;
+        return 0;
+    }
+
+    if( last && at > last->offset + last->remove + pending->delta ){
+        a = pending->len;
+        delta = pending->delta;
+    }
+
+    for( ; a < pending->len; ++a ){
+        if( edits[a].offset + delta + (off_t)edits[a].len >= at ){
+            break;
+        }
+        delta += (off_t)edits[a].len - edits[a].remove;
+    }
+
+    after = delta;
+    for( b = a; b < pending->len && edits[b].offset + after <= at + n; ++b ){
+        after += (off_t)edits[b].len - edits[b].remove;
+    }
+
+    memset(&merged, 0, sizeof(merged));
+
+    if( a == b ){
+        /* touches nothing, everything replaced is as on disk */
+        merged.offset = at - delta;
+        merged.remove = n;
+    } else {
+        first = &(edits[a]);
+        last = &(edits[b - 1]);
+        start = first->offset + delta;
+        end = last->offset + after - ((off_t)last->len - last->remove);
+
+        if( at > start ){
+            head = at - start;
+            merged.offset = first->offset;
+        } else {
+            merged.offset = at - delta;
+        }
+
+        if( at + n < end + (off_t)last->len ){
+            tail = end + last->len - (at + n);
+            merged.remove = last->offset + last->remove - merged.offset;
+        } else {
+            merged.remove = last->offset + last->remove + (at + n - end - (off_t)last->len) - merged.offset;
+        }
+    }
+
+    merged.len = head + len + tail;
+    if( merged.len ){
+        merged.str = malloc(merged.len);
+        if( ! merged.str ){
+            puts("edit_splice: call to malloc failed");
+            return 1;
+        }
+        if( head ){
+            memcpy(merged.str, first->str, head);
+        }
+        if( len ){
+            memcpy(merged.str + head, str, len);
+        }
+        if( tail ){
+            memcpy(merged.str + head + len, last->str + last->len - tail, tail);
+        }
+    }
+
+    for( k = a; k < b; ++k ){
+        free(edits[k].str);
+    }
+
+    /* make room for merged in place of edits a to b - 1 */
+    if( a == b && pending->len == pending->cap ){
+        pending->cap = pending->cap ? 2 * pending->cap : 64;
+        edits = realloc(pending->edits, pending->cap * sizeof(*edits));
+        if( ! edits ){
+            puts("edit_splice: call to realloc failed");
+            free(merged.str);
+            return 1;
+        }
+        pending->edits = edits;
+    }
+
+    if( merged.len || merged.remove ){
+        memmove(&(edits[a + 1]), &(edits[b]), (pending->len - b) * sizeof(*edits));
+        edits[a] = merged;
+        pending->len = pending->len + 1 - (b - a);
+    } else {
+        /* insert and delete cancelled out */
+        memmove(&(edits[a]), &(edits[b]), (pending->len - b) * sizeof(*edits));
+        pending->len -= b - a;
+    }
+
+    pending->delta += (off_t)len - n;
+    return 0;
+}
+
+/* as engine view but of the file as edited so far
+ * bytes are put together in p->pending.buf
+ *
+ * returns pointer to data on success
+ * returns 0 on failure
+ */
+const char * edit_view(struct Program *p, size_t len, off_t offset, size_t *nr){
+    struct Pending *pending = &(p->pending);
+    const struct Edit *edit = 0;
+    const char *data = 0;
+    char *buf = 0;
+    off_t size = p->engine->size(p);
+    off_t delta = 0;
+    /* next edited offset to fill and where to stop */
+    off_t at = offset;
+    off_t stop = offset + (off_t)len;
+    /* edited offset of next edit's str, or end of file */
+    off_t start = 0;
+    off_t upto = 0;
+    size_t got = 0;
+    size_t k = 0;
+
+    if( size == -1 ){
+        return 0;
+    }
+
+    if( pending->buf_len < len + 1 ){
+        buf = realloc(pending->buf, len + 1);
+        if( ! buf ){
+            puts("edit_view: call to realloc failed");
+            return 0;
+        }
+        pending->buf = buf;
+        pending->buf_len = len + 1;
+    }
+
+    for( k = 0; k <= pending->len && at < stop; ++k ){
+        edit = k < pending->len ? &(pending->edits[k]) : 0;
+
+        /* bytes on disk up to next edit */
+        start = (edit ? edit->offset : size) + delta;
+        if( at < start ){
+            upto = start < stop ? start : stop;
+            data = p->engine->view(p, 0, upto - at, at - delta, &got);
+            if( ! data ){
+                return 0;
+            }
+            memcpy(pending->buf + (at - offset), data, got);
+            at += got;
+            if( at < upto ){
+                /* file is shorter than it was */
+                break;
+            }
+        }
+
+        if( ! edit || at >= stop ){
+            break;
+        }
+
+        /* then the edit's str */
+        if( at < start + (off_t)edit->len ){
+            upto = start + (off_t)edit->len < stop ? start + (off_t)edit->len : stop;
+            memcpy(pending->buf + (at - offset), edit->str + (at - start), upto - at);
+            at = upto;
+        }
+
+        delta += (off_t)edit->len - edit->remove;
+    }
+
+    *nr = at > offset ? at - offset : 0;
+    return pending->buf;
+}
+
+/* forget every pending edit */
+void edit_free(struct Program *p){
+    size_t k = 0;
+
+    for( k = 0; k < p->pending.len; ++k ){
+        free(p->pending.edits[k].str);
+    }
+
+    p->pending.len = 0;
+    p->pending.delta = 0;
+}
+
+/* move [from, to) of the file by shift bytes through buf of BLOCK_SIZE bytes
+ * a block at a time, from the end if moving towards it
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int edit_move(struct Program *p, char *buf, off_t from, off_t to, off_t shift){
+    const char *data = 0;
+    off_t at = 0;
+    size_t want = 0;
+    size_t nr = 0;
+
+    while( from < to ){
+        want = to - from < BLOCK_SIZE ? (size_t)(to - from) : BLOCK_SIZE;
+        at = shift > 0 ? to - (off_t)want : from;
+
+        data = p->engine->view(p, buf, want, at, &nr);
+        if( ! data || nr != want ){
+            puts("edit_move: failed to read file");
+            return 1;
+        }
+
+        /* a mapping's view may overlap where it is going */
+        if( data != buf ){
+            memcpy(buf, data, nr);
+        }
+
+        if( p->engine->write(p, buf, nr, at + shift) != nr ){
+            puts("edit_move: failed to write file");
+            return 1;
+        }
+
+        if( shift > 0 ){
+            to -= want;
+        } else {
+            from += want;
+        }
+    }
+
+    return 0;
+}
+
+/* apply every pending edit in one pass
+ *
+ * the stretches of file between edits each move by the change in length of
+ * the edits before them, so every byte after the first edit moves at most
+ * once, those moving back are moved first working forwards and then those
+ * moving on working backwards, so none are overwritten before being moved,
+ * then the inserted strings are written into the gaps left between them
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int edit_apply(struct Program *p){
+    struct Pending *pending = &(p->pending);
+    struct Edit *edits = pending->edits;
+    char *buf = 0;
+    off_t size = 0;
+    off_t delta = 0;
+    off_t to = 0;
+    /* offset of first edit changing length, -1 if none do */
+    off_t moved = -1;
+    int ret = 1;
+    size_t k = 0;
+
+    if( ! pending->len ){
+        return 0;
+    }
+
+    size = p->engine->size(p);
+    buf = get_block(p);
+    if( size == -1 || ! buf ){
+        puts("edit_apply: unable to start");
+        goto EXIT;
+    }
+
+    /* grow file first so a mapping need not be replaced mid pass */
+    if( pending->delta > 0 && p->engine->truncate(p, size + pending->delta) ){
+        goto EXIT;
+    }
+
+    /* stretch k runs from the end of edit k - 1 to the start of edit k,
+     * delta is the change from the edits before it
+     */
+    for( k = 1, delta = 0; k <= pending->len; ++k ){
+        delta += (off_t)edits[k - 1].len - edits[k - 1].remove;
+        to = k < pending->len ? edits[k].offset : size;
+        if( delta < 0 && edit_move(p, buf, edits[k - 1].offset + edits[k - 1].remove, to, delta) ){
+            goto EXIT;
+        }
+    }
+
+    for( k = pending->len; k > 0; --k ){
+        to = k < pending->len ? edits[k].offset : size;
+        if( delta > 0 && edit_move(p, buf, edits[k - 1].offset + edits[k - 1].remove, to, delta) ){
+            goto EXIT;
+        }
+        delta -= (off_t)edits[k - 1].len - edits[k - 1].remove;
+    }
+
+    for( k = 0, delta = 0; k < pending->len; ++k ){
+        /* until the first edit changing length nothing has moved,
+         * only newlines written over can be lost
+         */
+        if(    p->index && moved == -1
+            && edits[k].len == (size_t)edits[k].remove
+            && index_write(p, edits[k].str, edits[k].len, edits[k].offset)
+        ){
+            goto EXIT;
+        }
+        if( moved == -1 && edits[k].len != (size_t)edits[k].remove ){
+            moved = edits[k].offset;
+        }
+
+        if( edits[k].len && p->engine->write(p, edits[k].str, edits[k].len, edits[k].offset + delta) != edits[k].len ){
+            puts("edit_apply: failed to write inserted string");
+            goto EXIT;
+        }
+        delta += (off_t)edits[k].len - edits[k].remove;
+    }
+
+    /* the writes may all still be under way */
+    if( p->engine->flush(p) ){
+        puts("edit_apply: failed to write edits");
+        goto EXIT;
+    }
+
+    if( pending->delta < 0 && p->engine->truncate(p, size + pending->delta) ){
+        goto EXIT;
+    }
+
+    /* every newline after the first edit changing length may have moved */
+    if( p->index && moved != -1 ){
+        index_invalidate(p->index, moved);
+    }
+
+    ret = 0;
+
+EXIT:
+    edit_free(p);
+    return ret;
+}
+
+/* apply pending edits if PENDING_MAX are already held, ahead of another
+ * offsets in the edited file stay where they were
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int edit_room(struct Program *p){
+    if( p->pending.len < PENDING_MAX ){
+        return 0;
+    }
+
+    if( edit_apply(p) ){
+        puts("edit_room: failed to apply pending edits");
+        return 1;
+    }
+
+    return 0;
+}
+
+/***** parsing functions *****/
+
+/* parsing helper method for parsing a string argument to a command
+ * used for expect e/string/
+ * and for write w/string/
+ * and for search /string/ and ?string?
+ *
+ * string is enclosed by delim, a delim within string can be escaped with '\'
+ *
+ * source must be a c-string meaning that is is an array of characters
+ * terminated by the null-terminator ('\0')
+ *
+ * returns instruction on success
+ * 0 on error
+ */
+struct Instruction * parse_delimited(struct Instruction *i, char *source, size_t *index, char delim){
+    int len = 0;
+
+    /* check arguments */
+    if( ! i ){
+        puts("parse_string: null instruction");
+        return 0;
+    }
+
+    if( ! source ){
+        puts("parse_string: null source");
+        return 0;
+    }
+
+    if( ! index ){
+        puts("parse_string: null index");
+        return 0;
+    }
+
+
+    if( delim != source[*index] ){
+        printf("Parse_string: unexpected character '%c', expected beginning delimiter'%c'\n", source[*index], delim);
+        return 0;
+    }
+
+    /* skip past starting delimiter */
+    ++(*index);
+
+    /* save start of string */
+    i->argument.str = &(source[*index]);
+
+    /* count length of string
+     * escape characters are dropped by copying the string down over them as
+     * it is read, so the rest of source is left where it is
+     */
+    for( len=0; ; ++(*index) ){
+        switch( source[*index] ){
+            /* end of buffer */
+            case '\0':
+                /* error, expected terminating delimiter */
+                printf("parse_string: unexpected end of source buffer, expected terminating delimiter'%c'\n", delim);
+                return 0;
+                break;
+
+            case '\\':
+                /* character after escape is taken as it is */
+                ++(*index);
+                if( source[*index] == '\0' ){
+                    printf("parse_string: unexpected end of source buffer, expected terminating delimiter'%c'\n", delim);
+                    return 0;
+                }
+                i->argument.str[len++] = source[*index];
+                break;
+
+            default:
+                /* terminating delimiter */
+                if( source[*index] == delim ){
+                    /* skip past delimiter */
+                    ++(*index);
+                    /* we are finished here */
+                    goto EXIT;
+                }
+
+                /* just another character in our string */
+                i->argument.str[len++] = source[*index];
+                break;
+        }
+    }
+
+EXIT:
+
+    i->argument.num = len;
+
+    return i;
+}
+
+/* parse string argument enclosed by '/', see parse_delimited */
+struct Instruction * parse_string(struct Instruction *i, char *source, size_t *index){
+    return parse_delimited(i, source, index, '/');
+}
+
+/* parsing helper method for parsing a number argument to a command
+ * used for byte bnumber
+ *
+ * returns instruction on success
+ * 0 on error
+ */
+struct Instruction * parse_number(struct Instruction *i, char *source, size_t *index){
+    char *endptr = 0;
+
+    /* check arguments */
+    if( ! i ){
+        puts("parse_number: null instruction");
+        return 0;
+    }
+
+    if( ! source ){
+        puts("parse_number: null source");
+        return 0;
+    }
+
+    if( ! index ){
+        puts("parse_number: null index");
+        return 0;
+    }
+    /* read in number
+     * `0` as base for `automatic` base selection
+     */
+    i->argument.num = strtoll(&(source[*index]), &endptr, 0);
+
+    /* advance past number ourselves to check strtoll consumed whole number
+     *
+     * strtoll supports
+     *  <decimal number>
+     *  0<octal number>
+     *  0x<hexadecimal number>
+     *
+     * first skip past any leading 0 or 0x
+     * then find where we think the number should end
+     * finally compare that to where strtoll stopped.
+     */
+    if( source[*index] == '0' ){
+        ++(*index);
+        if( source[*index] == 'x' ){
+            ++(*index);
+        }
+    }
+
+    for( ; ; ++(*index) ){
+        switch( source[*index] ){
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                break;
+
+            default:
+                goto EXIT;
+                break;
+        }
+    }
+
+EXIT:
+
+    if( endptr != &(source[*index]) ){
+        puts("parse_number: error when reading in number");
+        return 0;
+    }
+
+    return i;
+}
+
+struct Instruction * parse_print(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+    enum Command command = PRINT;
+
+    /* p, c and x differ only in how the bytes are shown */
+    switch( source[*index] ){
+        case 'p':
+        case 'P':
+            command = PRINT;
+            break;
+
+        case 'c':
+        case 'C':
+            command = RAW;
+            break;
+
+        case 'x':
+        case 'X':
+            command = HEXDUMP;
+            break;
+
+        default:
+            printf("parse_print: unexpected character '%c', expected 'p', 'c' or 'x'\n", source[*index]);
+            return 0;
+            break;
+    }
+    ++(*index);
+
+    i = new_instruction(p, command);
+    if( ! i ){
+        puts("parse_print: call to new_instruction failed");
+        return 0;
+    }
+
+    /* print has 2 different forms
+     *  p127
+     *  p
+     * if next character is a number then we are in the first form
+     */
+    if( isdigit(source[*index]) ){
+        return parse_number(i, source, index);
+    }
+
+    /* otherwise there is no number and we are in second form (default to 100 bytes) */
+    return i;
+}
+
+struct Instruction * parse_byte(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, BYTE);
+    if( ! i ){
+        puts("parse_byte: call to new_instruction failed");
+        return 0;
+    }
+
+    /* bn where n is positive integer */
+    switch( source[*index] ){
+        case 'b':
+        case 'B':
+            ++(*index);
+            break;
+        default:
+            printf("parse_byte: unexpected character '%c', expected 'b'\n", source[*index]);
+            return 0;
+            break;
+    }
+
+    return parse_number(i, source, index);
+}
+
+struct Instruction * parse_line(struct Program *p, char *source, size_t *index){
+    struct Instruction *ret = 0;
+    struct Instruction *i = 0;
+    /* sign of relative line numbers */
+    int sign = 1;
+
+    i = new_instruction(p, LINE);
+    if( ! i ){
+        puts("parse_line: call to new_instruction failed");
+        return 0;
+    }
+
+    /* line has 4 different forms
+     *  ln      where n is positive integer
+     *  l+n     where n is non-negative integer
+     *  l-n     where n is non-negative integer
+     *  l$ and l$-n
+     */
+    switch( source[*index] ){
+        case 'l':
+        case 'L':
+            ++(*index);
+            break;
+        default:
+            printf("parse_line: unexpected character '%c', expected 'l'\n", source[*index]);
+            return 0;
+            break;
+    }
+
+    i->argument.whence = SEEK_SET;
+
+    switch( source[*index] ){
+        case '+':
+        case '-':
+            i->argument.whence = SEEK_CUR;
+            break;
+
+        case '$':
+            i->argument.whence = SEEK_END;
+            ++(*index);
+            /* l$ on its own is the last line */
+            if( source[*index] != '-' ){
+                return i;
+            }
+            break;
+    }
+
+    /* sign is consumed here so parse_number only ever sees digits */
+    if( i->argument.whence != SEEK_SET ){
+        sign = source[*index] == '-' ? -1 : 1;
+        ++(*index);
+        if( ! isdigit(source[*index]) ){
+            printf("parse_line: unexpected character '%c', expected number\n", source[*index]);
+            return 0;
+        }
+    }
+
+    ret = parse_number(i, source, index);
+
+    if( ret && i->argument.whence == SEEK_SET && i->argument.num == 0 ){
+        puts("parse_line: line number must be > 0\n");
+        ret = 0;
+    }
+
+    if( ret == 0 ){
+        return 0;
+    }
+
+    i->argument.num *= sign;
+
+    return ret;
+}
+
+/* parsing helper for an optional count of bytes, into i->argument.count
+ * count is -1 if there is none
+ *
+ * returns instruction on success
+ * 0 on error
+ */
+struct Instruction * parse_count(struct Instruction *i, char *source, size_t *index){
+    long long int num = i->argument.num;
+
+    i->argument.count = -1;
+
+    if( isdigit(source[*index]) ){
+        if( ! parse_number(i, source, index) ){
+            return 0;
+        }
+        i->argument.count = i->argument.num;
+        i->argument.num = num;
+    }
+
+    return i;
+}
+
+/* parsing helper for the checksum and count of e#hash#count
+ * the count is optional, without it the checksum covers the rest of the file
+ *
+ * returns instruction on success
+ * 0 on error
+ */
+struct Instruction * parse_checksum(struct Instruction *i, char *source, size_t *index){
+    int digits = 0;
+    int c = 0;
+
+    /* #hash# */
+    ++(*index);
+    for( digits = 0; isxdigit(source[*index]); ++digits, ++(*index) ){
+        c = tolower(source[*index]);
+        i->argument.num = i->argument.num * 16 + (isdigit(c) ? c - '0' : c - 'a' + 10);
+    }
+
+    if( digits < 1 || digits > 8 || source[*index] != '#' ){
+        puts("parse_checksum: expected checksum of 1 to 8 hex digits between '#'");
+        return 0;
+    }
+    ++(*index);
+
+    return parse_count(i, source, index);
+}
+
+struct Instruction * parse_expect(struct Program *p, char *source, size_t *index){
+    struct Instruction *ret = 0;
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, EXPECT);
+    if( ! i ){
+        puts("parse_expect: call to new_instruction failed");
+        return 0;
+    }
+
+    /* e/string/ */
+    switch( source[*index] ){
+        case 'e':
+        case 'E':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_expect: unexpected character '%c', expected 'e'\n", source[*index]);
+            return 0;
+            break;
+    }
+
+    /* e#hash#count checks a checksum rather than the bytes themselves */
+    if( source[*index] == '#' ){
+        i->command = EXPECT_HASH;
+        return parse_checksum(i, source, index);
+    }
+
+    ret = parse_string(i, source, index);
+
+    return ret;
+}
+
+struct Instruction * parse_hash(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, HASH);
+    if( ! i ){
+        puts("parse_hash: call to new_instruction failed");
+        return 0;
+    }
+
+    switch( source[*index] ){
+        case 'h':
+        case 'H':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_hash: unexpected character '%c', expected 'h'\n", source[*index]);
+            return 0;
+            break;
+    }
+
+    /* hash has 2 forms
+     *  h4096
+     *  h
+     * the second hashing up to the end of the file
+     */
+    return parse_count(i, source, index);
+}
+
+struct Instruction * parse_write(struct Program *p, char *source, size_t *index){
+    struct Instruction *ret = 0;
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, WRITE);
+    if( ! i ){
+        puts("parse_write: call to new_instruction failed");
+        return 0;
+    }
+
+    /* w/string/ */
+    switch( source[*index] ){
+        case 'w':
+        case 'W':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_write: unexpected character '%c', expected 'w'\n", source[*index]);
+            return 0;
+            break;
+    }
+    ret = parse_string(i, source, index);
+
+    return ret;
+}
+
+struct Instruction * parse_write_file(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+    long long int len = 0;
+
+    i = new_instruction(p, WRITE_FILE);
+    if( ! i ){
+        puts("parse_write_file: call to new_instruction failed");
+        return 0;
+    }
+
+    switch( source[*index] ){
+        case 'f':
+        case 'F':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_write_file: unexpected character '%c', expected 'f'\n", source[*index]);
+            return 0;
+            break;
+    }
+
+    /* write file has 3 forms
+     *  f/path/
+     *  f/path/from
+     *  f/path/from,count
+     * the first copying all of path, the second the rest of it after from
+     */
+    if( ! parse_string(i, source, index) ){
+        return 0;
+    }
+    len = i->argument.num;
+    i->argument.count = -1;
+
+    if( len == 0 ){
+        puts("parse_write_file: path must not be empty");
+        return 0;
+    }
+
+    if( isdigit(source[*index]) ){
+        if( ! parse_number(i, source, index) ){
+            return 0;
+        }
+        i->argument.from = i->argument.num;
+
+        if( source[*index] == ',' ){
+            ++(*index);
+            if( ! isdigit(source[*index]) ){
+                printf("parse_write_file: unexpected character '%c', expected count\n", source[*index]);
+                return 0;
+            }
+            if( ! parse_number(i, source, index) ){
+                return 0;
+            }
+            i->argument.count = i->argument.num;
+        }
+    }
+    i->argument.num = len;
+
+    return i;
+}
+
+struct Instruction * parse_insert(struct Program *p, char *source, size_t *index){
+    struct Instruction *ret = 0;
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, INSERT);
+    if( ! i ){
+        puts("parse_insert: call to new_instruction failed");
+        return 0;
+    }
+
+    /* i/string/ */
+    switch( source[*index] ){
+        case 'i':
+        case 'I':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_insert: unexpected character '%c', expected 'i'\n", source[*index]);
+            return 0;
+            break;
+    }
+    ret = parse_string(i, source, index);
+
+    return ret;
+}
+
+struct Instruction * parse_delete(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, DELETE);
+    if( ! i ){
+        puts("parse_delete: call to new_instruction failed");
+        return 0;
+    }
+
+    switch( source[*index] ){
+        case 'd':
+        case 'D':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_delete: unexpected character '%c', expected 'd'\n", source[*index]);
+            return 0;
+            break;
+    }
+
+    /* delete has 2 forms like print
+     *  d5
+     *  d
+     * the second deleting a single byte
+     */
+    if( isdigit(source[*index]) ){
+        return parse_number(i, source, index);
+    }
+
+    return i;
+}
+
+struct Instruction * parse_substitute(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+    char *old = 0;
+    long long int len = 0;
+
+    i = new_instruction(p, SUBSTITUTE);
+    if( ! i ){
+        puts("parse_substitute: call to new_instruction failed");
+        return 0;
+    }
+
+    /* s/old/new/g */
+    switch( source[*index] ){
+        case 's':
+        case 'S':
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_substitute: unexpected character '%c', expected 's'\n", source[*index]);
+            return 0;
+    }
+
+    if( ! parse_string(i, source, index) ){
+        return 0;
+    }
+    old = i->argument.str;
+    len = i->argument.num;
+
+    /* middle delimiter closes old and opens new */
+    --(*index);
+    if( ! parse_string(i, source, index) ){
+        return 0;
+    }
+    i->argument.replace = i->argument.str;
+    i->argument.str = old;
+
+    if( len == 0 ){
+        puts("parse_substitute: string to replace must not be empty");
+        return 0;
+    }
+
+    if( i->argument.num != len ){
+        printf("parse_substitute: replacement is %lld bytes but must be the same length as '%.*s' (%lld bytes)\n",
+               i->argument.num, (int)len, old, len);
+        return 0;
+    }
+
+    if( source[*index] != 'g' ){
+        puts("parse_substitute: only global substitution s/old/new/g is supported");
+        return 0;
+    }
+    ++(*index);
+
+    return i;
+
+}
+
+struct Instruction * parse_search(struct Program *p, char *source, size_t *index){
+    struct Instruction *ret = 0;
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, SEARCH);
+    if( ! i ){
+        puts("parse_search: call to new_instruction failed");
+        return 0;
+    }
+
+    /* /string/
+     * the command is its own opening delimiter, so leave it for parse_string
+     */
+    ret = parse_string(i, source, index);
+    if( ret == 0 ){
+        return 0;
+    }
+
+    if( i->argument.num == 0 ){
+        puts("parse_search: search string must not be empty");
+        return 0;
+    }
+
+    return ret;
+}
+
+struct Instruction * parse_search_back(struct Program *p, char *source, size_t *index){
+    struct Instruction *ret = 0;
+    struct Instruction *i = 0;
+
+    i = new_instruction(p, SEARCH_BACK);
+    if( ! i ){
+        puts("parse_search_back: call to new_instruction failed");
+        return 0;
+    }
+
+    /* ?string?
+     * as for search the command is its own opening delimiter
+     */
+    ret = parse_delimited(i, source, index, '?');
+    if( ret == 0 ){
+        return 0;
+    }
+
+    if( i->argument.num == 0 ){
+        puts("parse_search_back: search string must not be empty");
+        return 0;
+    }
+
+    return ret;
+}
+
+struct Instruction * parse_regex(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+
+    switch( source[*index] ){
+        case 'r':
+        case 'R':
+            /* advance past letter */
+            ++(*index);
+            break;
+
+        default:
+            printf("parse_regex: unexpected character '%c', expected 'r'\n", source[*index]);
+            return 0;
+    }
+
+    /* r/pattern/ */
+    if( source[*index] != '/' ){
+        printf("parse_regex: unexpected character '%c', expected beginning delimiter '/'\n", source[*index]);
+        return 0;
+    }
+    ++(*index);
+
+    i = new_instruction(p, REGEX);
+    if( ! i ){
+        puts("parse_regex: call to new_instruction failed");
+        return 0;
+    }
+
+    /* unlike parse_string escapes are left in place for dfa_compile,
+     * which reads '\/' as '/' like any other escaped byte
+     */
+    i->argument.str = &(source[*index]);
+    for( ; source[*index] != '/'; ++(*index) ){
+        if( source[*index] == '\0' ){
+            puts("parse_regex: unexpected end of source buffer, expected terminating delimiter '/'");
+            return 0;
+        }
+        if( source[*index] == '\\' && source[*index + 1] != '\0' ){
+            ++(*index);
+        }
+    }
+    i->argument.num = &(source[*index]) - i->argument.str;
+
+    /* skip past delimiter */
+    ++(*index);
+
+    if( i->argument.num == 0 ){
+        puts("parse_regex: pattern must not be empty");
+        return 0;
+    }
+
+    i->argument.dfa = dfa_compile(i->argument.str, i->argument.num);
+    if( ! i->argument.dfa ){
+        puts("parse_regex: call to dfa_compile failed");
+        return 0;
+    }
+
+    return i;
+}
+
+struct Instruction * parse_truncate(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+
+    switch( source[*index] ){
+        case 't':
+        case 'T':
+            /* advance past letter */
+            ++(*index);
+            break;
+
+        default:
+            printf("Parse_truncate: unexpected character '%c', expected 't'\n", source[*index]);
+            return 0;
+    }
+
+
+    i = new_instruction(p, TRUNCATE);
+    if( ! i ){
+        puts("Parse_truncate: call to new_instruction failed");
+        return 0;
+    }
+
+    return i;
+}
+
+struct Instruction * parse_quit(struct Program *p, char *source, size_t *index){
+    struct Instruction *i = 0;
+
+    switch( source[*index] ){
+        case 'q':
+        case 'Q':
+            /* advance past letter */
+            ++(*index);
+        case '\0': /* treat \0 as implicit quit */
+            break;
+
+        default:
+            printf("parse_quit: unexpected character '%c'\n", source[*index]);
+            return 0;
+    }
+
+
+    i = new_instruction(p, QUIT);
+    if( ! i ){
+        puts("parse_quit: call to new_instruction failed");
+        return 0;
+    }
+
+    return i;
+}
+
+/* consume comment from source
+ * return 0 on success
+ * return 1 on error
+ */
+int parse_comment(char *source, size_t *index){
+
+    if( source[*index] != '#' ){
+        printf("parse_comment: expected '#', got '%c'\n", source[*index]);
+        return 1;
+    }
+
+    /* consume source until \n or \0 are found */
+    while( 1 ){
+        switch( source[*index] ){
+
+            case '\n':
+            case '\0':
+                /* end comment
+                 * leave character for parent to look at
+                 */
+                goto EXIT;
+                break;
+
+            default:
+                ++(*index);
+                break;
+
+        }
+    }
+
+EXIT:
+
+    return 0;
+}
+
+/* parse provided source into Program
+ * return 0 on success
+ * return 1 on failure
  */
 int parse(struct Program *program){
     /* index into source */
     size_t index = 0;
     /* result from call to parse_ functions */
     struct Instruction *res = 0;
-    /* place to store next parsed Instruction */
-    struct Instruction **store = 0;
     /* temporary pointer to program->source */
     char *source = 0;
 
-    if( ! program || ! program->source ){
-        puts("parse: called with null program or source");
+    if( ! program || ! program->source ){
+        puts("parse: called with null program or source");
+        return 1;
+    }
+
+    source = program->source;
+
+    while( source[index] ){
+        switch( source[index] ){
+            case 'p':
+            case 'P':
+            case 'c':
+            case 'C':
+            case 'x':
+            case 'X':
+                res = parse_print(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_print");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'b':
+            case 'B':
+                res = parse_byte(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_byte");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'l':
+            case 'L':
+                res = parse_line(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_line");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'e':
+            case 'E':
+                res = parse_expect(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_expect");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'w':
+            case 'W':
+                res = parse_write(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_write");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'h':
+            case 'H':
+                res = parse_hash(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_hash");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'f':
+            case 'F':
+                res = parse_write_file(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_write_file");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'i':
+            case 'I':
+                res = parse_insert(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_insert");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'd':
+            case 'D':
+                res = parse_delete(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_delete");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 's':
+            case 'S':
+                res = parse_substitute(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_substitute");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case '/':
+                res = parse_search(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_search");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case '?':
+                res = parse_search_back(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_search_back");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'r':
+            case 'R':
+                res = parse_regex(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_regex");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 't':
+            case 'T':
+                res = parse_truncate(program, source, &index);
+                if( ! res ){
+                    puts("Parse: failed in call to parse_truncate");
+                    return 1;
+                }
+                ++(program->code_len);
+                break;
+
+            case 'q':
+            case 'Q':
+                res = parse_quit(program, source, &index);
+                if( ! res ){
+                    puts("parse: failed in call to parse_quit");
+                    return 1;
+                }
+                ++(program->code_len);
+                goto EXIT;
+                break;
+
+            case '#':
+                if( parse_comment(source, &index) ){
+                    puts("parse: parsing comment failed");
+                    return 1;
+                }
+                break;
+
+            /* skip over whitespace
+             * whitespace is insignificant EXCEPT for \n denoting end of comment
+             */
+            case ' ':
+            case '\t':
+            case '\n':
+                /* actually skip over whitespace */
+                ++index;
+                break;
+
+            default:
+                printf("parse: Invalid character encountered '%c'\n", source[index]);
+                return 1;
+                break;
+        }
+    }
+
+EXIT:
+
+    return 0;
+}
+
+
+
+/***** compiled programs *****/
+
+/* fold len bytes of buf into 64 bit FNV-1a hash
+ * start from COMPILED_HASH_INIT
+ */
+unsigned long long compiled_hash(unsigned long long hash, const char *buf, size_t len){
+    size_t k = 0;
+
+    for( k = 0; k < len; ++k ){
+        hash ^= (unsigned char)buf[k];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/* write parsed program out to path as a compiled program
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int compiled_save(struct Program *p, const char *path){
+    struct CompiledHeader header;
+    struct CompiledRecord *records = 0;
+    const struct Instruction *i = 0;
+    FILE *file = 0;
+    /* offset into string bytes of the next string */
+    size_t strings = 0;
+    size_t k = 0;
+    int ret = 1;
+
+    records = calloc(p->code_len ? p->code_len : 1, sizeof(*records));
+    if( ! records ){
+        puts("compiled_save: call to calloc failed");
+        return 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_VERSION;
+    header.len = p->code_len;
+    header.hash = COMPILED_HASH_INIT;
+
+    /* each string is followed by a null byte */
+    for( k = 0; k < p->code_len; ++k ){
+        i = &(p->code[k]);
+        records[k].command = i->command;
+        records[k].whence = i->argument.whence;
+        records[k].num = i->argument.num;
+        records[k].from = i->argument.from;
+        records[k].count = i->argument.count;
+        records[k].str = -1;
+        records[k].replace = -1;
+        if( i->argument.str ){
+            records[k].str = strings;
+            strings += i->argument.num + 1;
+        }
+        if( i->argument.replace ){
+            records[k].replace = strings;
+            strings += i->argument.num + 1;
+        }
+    }
+    header.strings = strings;
+
+    header.hash = compiled_hash(header.hash, (const char *)records, p->code_len * sizeof(*records));
+    for( k = 0; k < p->code_len; ++k ){
+        i = &(p->code[k]);
+        if( i->argument.str ){
+            header.hash = compiled_hash(header.hash, i->argument.str, i->argument.num);
+            header.hash = compiled_hash(header.hash, "", 1);
+        }
+        if( i->argument.replace ){
+            header.hash = compiled_hash(header.hash, i->argument.replace, i->argument.num);
+            header.hash = compiled_hash(header.hash, "", 1);
+        }
+    }
+
+    file = fopen(path, "wb");
+    if( ! file ){
+        printf("compiled_save: failed to open '%s'\n", path);
+        goto EXIT;
+    }
+
+    if(    1 != fwrite(&header, sizeof(header), 1, file)
+        || p->code_len != fwrite(records, sizeof(*records), p->code_len, file)
+    ){
+        goto WRITE_FAILED;
+    }
+
+    for( k = 0; k < p->code_len; ++k ){
+        i = &(p->code[k]);
+        if(    i->argument.str
+            && (    (size_t)i->argument.num != fwrite(i->argument.str, 1, i->argument.num, file)
+                 || EOF == fputc('\0', file) )
+        ){
+            goto WRITE_FAILED;
+        }
+        if(    i->argument.replace
+            && (    (size_t)i->argument.num != fwrite(i->argument.replace, 1, i->argument.num, file)
+                 || EOF == fputc('\0', file) )
+        ){
+            goto WRITE_FAILED;
+        }
+    }
+
+    ret = 0;
+    goto EXIT;
+
+WRITE_FAILED:
+    printf("compiled_save: failed to write '%s'\n", path);
+
+EXIT:
+    if( file && fclose(file) ){
+        printf("compiled_save: failed to close '%s'\n", path);
+        ret = 1;
+    }
+    free(records);
+    return ret;
+}
+
+/* map compiled program at path and fill p->code from it
+ * strings are used where they lie in the private mapping of the file,
+ * regular expressions are compiled again as dfas cannot be saved
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int compiled_load(struct Program *p, const char *path){
+    const struct CompiledHeader *header = 0;
+    const struct CompiledRecord *records = 0;
+    const struct CompiledRecord *r = 0;
+    struct Instruction *i = 0;
+    struct stat st;
+    char *strings = 0;
+    size_t k = 0;
+    int fd = -1;
+    int ret = 1;
+
+    fd = open(path, O_RDONLY);
+    if( fd == -1 ){
+        printf("compiled_load: failed to open '%s'\n", path);
+        return 1;
+    }
+
+    if( fstat(fd, &st) ){
+        perror("compiled_load: error in call to fstat");
+        goto EXIT;
+    }
+
+    if( (size_t)st.st_size < sizeof(*header) ){
+        printf("compiled_load: '%s' is not a compiled program\n", path);
+        goto EXIT;
+    }
+
+    /* strings are only read once parsed, so the mapping can be too */
+    p->image = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if( p->image == MAP_FAILED ){
+        p->image = 0;
+        perror("compiled_load: error in call to mmap");
+        goto EXIT;
+    }
+    p->image_len = st.st_size;
+
+    header = (const struct CompiledHeader *)p->image;
+    records = (const struct CompiledRecord *)(p->image + sizeof(*header));
+
+    if(    strncmp(header->magic, COMPILED_MAGIC, sizeof(header->magic))
+        || header->version != COMPILED_VERSION
+        || header->len > (p->image_len - sizeof(*header)) / sizeof(*records)
+        || p->image_len - sizeof(*header) - header->len * sizeof(*records) != header->strings
+    ){
+        printf("compiled_load: '%s' is not a compiled program of this version\n", path);
+        goto EXIT;
+    }
+
+    if( header->hash != compiled_hash(COMPILED_HASH_INIT, p->image + sizeof(*header), p->image_len - sizeof(*header)) ){
+        printf("compiled_load: checksum of '%s' does not match, it is damaged\n", path);
+        goto EXIT;
+    }
+
+    strings = p->image + sizeof(*header) + header->len * sizeof(*records);
+
+    for( k = 0; k < header->len; ++k ){
+        r = &(records[k]);
+
+        /* num is the length of any strings, and only then never negative */
+        if(    r->command < PRINT || r->command > QUIT
+            || (r->command == LINE && r->whence != SEEK_SET && r->whence != SEEK_CUR && r->whence != SEEK_END)
+            || (r->command == LINE && r->whence == SEEK_SET && r->num < 1)
+            || (r->command == LINE && r->whence == SEEK_END && r->num > 0)
+            || ((r->command == SEARCH || r->command == SEARCH_BACK) && (r->str == -1 || r->num == 0))
+            || ((r->command == EXPECT || r->command == WRITE || r->command == INSERT) && r->str == -1)
+            || (r->command == REGEX && r->str == -1)
+            || (r->command == SUBSTITUTE && (r->str == -1 || r->replace == -1))
+            || (r->command == WRITE_FILE && (r->str == -1 || r->from < 0 || r->count < -1))
+            || ((r->command == HASH || r->command == EXPECT_HASH) && r->count < -1)
+            || (r->command == EXPECT_HASH && (r->num < 0 || r->num > 0xffffffffLL))
+            || (r->str != -1 && (r->num < 0 || r->str < 0 || (unsigned long long)r->str + r->num + 1 > header->strings))
+            || (r->replace != -1 && (r->num < 0 || r->replace < 0 || (unsigned long long)r->replace + r->num + 1 > header->strings))
+        ){
+            printf("compiled_load: instruction %zu of '%s' is invalid\n", k, path);
+            goto EXIT;
+        }
+
+        i = new_instruction(p, r->command);
+        if( ! i ){
+            goto EXIT;
+        }
+        i->argument.num = r->num;
+        i->argument.whence = r->whence;
+        i->argument.from = r->from;
+        i->argument.count = r->count;
+        i->argument.str = r->str == -1 ? 0 : strings + r->str;
+        i->argument.replace = r->replace == -1 ? 0 : strings + r->replace;
+
+        if( i->command == REGEX ){
+            i->argument.dfa = dfa_compile(i->argument.str, i->argument.num);
+            if( ! i->argument.dfa ){
+                puts("compiled_load: call to dfa_compile failed");
+                goto EXIT;
+            }
+        }
+
+        ++(p->code_len);
+    }
+
+    ret = 0;
+
+EXIT:
+    close(fd);
+    return ret;
+}
+
+
+/***** evaluation functions *****/
+
+/* bytes print, raw and hexdump take from the file at a time,
+ * however many they are asked for
+ */
+#define PRINT_CHUNK BLOCK_SIZE
+/* bytes on each line of a hexdump */
+#define HEXDUMP_WIDTH 32
+/* longest line of a hexdump, 16 digit offset, 2 spaces, digits and newline */
+#define HEXDUMP_LINE (16 + 2 + 2 * HEXDUMP_WIDTH + 1)
+
+/* as engine view but of the file as edited so far, copying into the block buffer
+ * returns pointer to data on success
+ * returns 0 on failure
+ */
+const char * print_view(struct Program *p, size_t len, off_t offset, size_t *nr){
+    char *block = 0;
+
+    if( p->pending.len ){
+        return edit_view(p, len, offset, nr);
+    }
+
+    block = get_block(p);
+    if( ! block ){
+        puts("print_view: call to get_block failed");
+        return 0;
+    }
+
+    return p->engine->view(p, block, len, offset, nr);
+}
+
+/* eval PRINT command
+ * print specified number of bytes, quoted
+ * defaults to 100 bytes if number isn't specified
+ *
+ *  p
+ *  p127
+ *
+ * bytes are read and written out PRINT_CHUNK at a time
+ *
+ * uses cur->argument.num
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_print(struct Program *p, struct Instruction *cur){
+    /* number of bytes to print */
+    long long int num = cur->argument.num;
+    const char *buf = 0;
+    /* number of bytes printed so far */
+    long long int done = 0;
+    size_t want = 0;
+    /* number of bytes read */
+    size_t nr = 0;
+
+    /* default to 100 bytes */
+    if( ! num ){
+        num = 100;
+    }
+
+    putchar('\'');
+
+    for( done = 0; done < num; done += nr ){
+        want = num - done < PRINT_CHUNK ? num - done : PRINT_CHUNK;
+        buf = print_view(p, want, p->offset + done, &nr);
+        if( ! buf ){
+            puts("eval_print: failed to read file");
+            return 1;
+        }
+
+        /* print buffer, as instructed, null bytes and all */
+        if( nr != fwrite(buf, 1, nr, stdout) ){
+            puts("eval_print: failed to write to stdout");
+            return 1;
+        }
+
+        /* end of file */
+        if( nr < want ){
+            break;
+        }
+    }
+
+    puts("'");
+
+    return 0;
+}
+
+/* eval RAW command
+ * copy specified number of bytes to stdout exactly as they are
+ * defaults to 100 bytes if number isn't specified
+ *
+ *  c
+ *  c4096
+ *
+ * without pending edits to fold in sendfile moves the bytes straight
+ * from the file to stdout where it is a regular file,
+ * otherwise they go through stdio PRINT_CHUNK at a time
+ * a pipe is left out as sendfile hands it the cached pages themselves,
+ * so a later write to the file would show in bytes already printed
+ *
+ * uses cur->argument.num
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_raw(struct Program *p, struct Instruction *cur){
+    /* number of bytes to copy */
+    long long int num = cur->argument.num;
+    const char *buf = 0;
+    /* number of bytes copied so far */
+    long long int done = 0;
+    size_t want = 0;
+    /* number of bytes read */
+    size_t nr = 0;
+#ifdef __linux__
+    off_t at = 0;
+    ssize_t ret = 0;
+    struct stat st;
+#endif
+
+    /* default to 100 bytes */
+    if( ! num ){
+        num = 100;
+    }
+
+#ifdef __linux__
+    /* sendfile from a file opened O_DIRECT would need aligned offsets */
+    if( ! p->pending.len && ! p->direct && ! fstat(STDOUT_FILENO, &st) && S_ISREG(st.st_mode) ){
+        /* anything already printed must come first */
+        if( fflush(stdout) ){
+            puts("eval_raw: failed to flush stdout");
+            return 1;
+        }
+        /* and writes an engine still has under way, as sendfile reads the file itself */
+        if( p->engine->flush(p) ){
+            puts("eval_raw: failed to finish writes");
+            return 1;
+        }
+
+        at = p->offset;
+        while( done < num ){
+            want = num - done < PRINT_CHUNK ? num - done : PRINT_CHUNK;
+            ret = sendfile(STDOUT_FILENO, p->fd, &at, want);
+            if( ret == -1 && errno == EINTR ){
+                continue;
+            }
+            if( ret == -1 && ! done && (errno == EINVAL || errno == ENOSYS) ){
+                /* the file system cannot take it */
+                break;
+            }
+            if( ret == -1 ){
+                perror("eval_raw: error in call to sendfile");
+                return 1;
+            }
+            if( ret == 0 ){
+                /* end of file */
+                return 0;
+            }
+            done += ret;
+        }
+    }
+#endif
+
+    for( ; done < num; done += nr ){
+        want = num - done < PRINT_CHUNK ? num - done : PRINT_CHUNK;
+        buf = print_view(p, want, p->offset + done, &nr);
+        if( ! buf ){
+            puts("eval_raw: failed to read file");
+            return 1;
+        }
+
+        if( nr != fwrite(buf, 1, nr, stdout) ){
+            puts("eval_raw: failed to write to stdout");
+            return 1;
+        }
+
+        /* end of file */
+        if( nr < want ){
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* eval HEXDUMP command
+ * print specified number of bytes in hex
+ * defaults to 100 bytes if number isn't specified
+ *
+ *  x
+ *  x4096
+ *
+ * every HEXDUMP_WIDTH bytes make a line led by the offset of the first
+ *
+ *  0000000000000400  68656c6c6f20776f726c640a
+ *
+ * the digits are encoded by scan_hex straight into place in the line,
+ * PRINT_CHUNK bytes at a time
+ *
+ * uses cur->argument.num
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_hexdump(struct Program *p, struct Instruction *cur){
+    /* number of bytes to dump */
+    long long int num = cur->argument.num;
+    const char *buf = 0;
+    /* lines put together for a chunk */
+    char *out = 0;
+    /* end of lines in out */
+    size_t len = 0;
+    /* number of bytes dumped so far */
+    long long int done = 0;
+    /* offset of line being put together */
+    unsigned long long int offset = 0;
+    size_t want = 0;
+    /* number of bytes read */
+    size_t nr = 0;
+    size_t width = 0;
+    size_t i = 0;
+    int k = 0;
+
+    /* default to 100 bytes */
+    if( ! num ){
+        num = 100;
+    }
+
+    for( done = 0; done < num; done += nr ){
+        want = num - done < PRINT_CHUNK ? num - done : PRINT_CHUNK;
+        buf = print_view(p, want, p->offset + done, &nr);
+        if( ! buf ){
+            puts("eval_hexdump: failed to read file");
+            return 1;
+        }
+
+        /* after the view, as edit_view may have used the shared buffer itself */
+        out = get_buffer(p, PRINT_CHUNK / HEXDUMP_WIDTH * HEXDUMP_LINE);
+        if( ! out ){
+            puts("eval_hexdump: call to get_buffer failed");
+            return 1;
+        }
+
+        len = 0;
+        for( i = 0; i < nr; i += width ){
+            width = nr - i < HEXDUMP_WIDTH ? nr - i : HEXDUMP_WIDTH;
+
+            offset = p->offset + done + i;
+            for( k = 15; k >= 0; --k ){
+                out[len + k] = "0123456789abcdef"[offset & 0x0f];
+                offset >>= 4;
+            }
+            out[len + 16] = ' ';
+            out[len + 17] = ' ';
+            len += 18;
+
+            scan_hex(buf + i, width, out + len);
+            len += 2 * width;
+            out[len++] = '\n';
+        }
+
+        if( len != fwrite(out, 1, len, stdout) ){
+            puts("eval_hexdump: failed to write to stdout");
+            return 1;
+        }
+
+        /* end of file */
+        if( nr < want ){
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* eval BYTE command
+ * move spcified number of bytes 'forward' through text
+ *
+ *  b427
+ *
+ * uses cur->argument.num
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_byte(struct Program *p, struct Instruction *cur){
+    /* byte number argument to seek to */
+    off_t byte = 0;
+
+    byte = cur->argument.num;
+
+    /* update file offset */
+    p->offset = byte;
+    p->engine->seek(p, p->offset);
+
+    return 0;
+}
+
+/* scan len bytes of buf, read from file offset base, for newlines
+ * counting them into *observed and stopping once it reaches target
+ * any checkpoints passed that the line index doesn't know of yet are recorded
+ *
+ * *end is set to the index just past the target newline,
+ * or to len if target wasn't reached
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int line_scan(struct Program *p, const char *buf, size_t len, off_t base, long long int *observed, long long int target, size_t *end){
+    /* newlines asked of, and still wanted by, scan_newlines */
+    size_t asked = 0;
+    size_t want = 0;
+    size_t i = 0;
+
+    while( i < len && *observed < target ){
+        asked = target - *observed;
+
+        /* stop at the first checkpoint index doesn't know of yet */
+        if(    p->index
+            && *observed / INDEX_INTERVAL + 1 == p->index->len
+            && INDEX_INTERVAL - *observed % INDEX_INTERVAL < asked
+        ){
+            asked = INDEX_INTERVAL - *observed % INDEX_INTERVAL;
+        }
+
+        want = asked;
+        i += scan_newlines(buf + i, len - i, &want);
+        *observed += asked - want;
+
+        /* rest of buf holds fewer newlines than asked for */
+        if( want ){
+            break;
+        }
+
+        /* i is now just past the \n ending line *observed */
+        if(    p->index
+            && *observed % INDEX_INTERVAL == 0
+            && *observed / INDEX_INTERVAL == p->index->len
+            && index_push(p->index, base + i)
+        ){
+            return 1;
+        }
+    }
+
+    *end = i;
+    return 0;
+}
+
+/* bytes each worker reads per round of a parallel line seek */
+#define CHUNK_SIZE (4 << 20)
+/* distance between workers' buffers, with room to widen reads to aligned bounds */
+#define CHUNK_STRIDE (CHUNK_SIZE + 2 * DIRECT_ALIGN)
+/* upper bound for -j */
+#define MAX_JOBS 64
+
+/* return buffers for p->jobs workers, each of CHUNK_SIZE bytes CHUNK_STRIDE apart
+ * aligned so workers can read a file opened O_DIRECT into them
+ * returns 0 on error
+ */
+char * get_chunks(struct Program *p){
+    void *chunks = 0;
+
+    if( p->chunks ){
+        return p->chunks;
+    }
+
+    if( posix_memalign(&chunks, DIRECT_ALIGN, (size_t)p->jobs * CHUNK_STRIDE) ){
+        puts("get_chunks: failed to allocate chunks");
+        return 0;
+    }
+
+    p->chunks = chunks;
+    return p->chunks;
+}
+
+/* one worker's share of a round of a parallel line seek */
+struct Chunk {
+    /* file descriptor to pread from, and whether it is open O_DIRECT */
+    int fd;
+    int direct;
+    /* file offset chunk starts at */
+    off_t offset;
+    /* buffer of CHUNK_SIZE bytes, holding len bytes read */
+    char *buf;
+    size_t len;
+    /* newlines found within buf */
+    size_t count;
+    /* errno of failed read, 0 on success */
+    int error;
+};
+
+/* worker thread for eval_line_parallel
+ * reads its chunk and counts every newline in it
+ */
+void * line_worker(void *arg){
+    struct Chunk *chunk = arg;
+    ssize_t nr = 0;
+    size_t want = (size_t)-1;
+
+    chunk->len = 0;
+    chunk->error = 0;
+
+    nr = pread_full(chunk->fd, chunk->direct, chunk->buf, CHUNK_SIZE, chunk->offset);
+    if( nr < 0 ){
+        chunk->error = errno;
+        return 0;
+    }
+    chunk->len = nr;
+
+    scan_newlines(chunk->buf, chunk->len, &want);
+    chunk->count = (size_t)-1 - want;
+
+    return 0;
+}
+
+/* find line by splitting the file after p->offset into rounds of p->jobs chunks
+ * workers count newlines in their chunk concurrently
+ * a running sum over the chunks then finds the chunk holding target,
+ * only that chunk is scanned again to find the exact offset
+ *
+ * chunks holding checkpoints unknown to the line index are also scanned again,
+ * so the index grows the same as it would for a sequential seek
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int eval_line_parallel(struct Program *p, long long int observed, long long int target){
+    struct Chunk chunks[MAX_JOBS];
+    pthread_t threads[MAX_JOBS];
+    /* offset of next round */
+    off_t offset = p->offset;
+    size_t end = 0;
+    int ret = 1;
+    int err = 0;
+    int j = 0;
+
+    if( ! get_chunks(p) ){
+        return 1;
+    }
+
+    /* workers pread the file, so writes an engine still has under way must land first */
+    if( p->engine->flush(p) ){
+        puts("eval_line_parallel: failed to finish writes");
+        return 1;
+    }
+
+    /* settle on a scan kernel before workers race to */
+    scan_kernel();
+
+    for( j = 0; j < p->jobs; ++j ){
+        chunks[j].fd = p->fd;
+        chunks[j].direct = p->direct;
+        chunks[j].buf = p->chunks + (size_t)j * CHUNK_STRIDE;
+    }
+
+    while( 1 ){
+        for( j = 0; j < p->jobs; ++j ){
+            chunks[j].offset = offset + (off_t)j * CHUNK_SIZE;
+            err = pthread_create(&threads[j], 0, line_worker, &chunks[j]);
+            if( err ){
+                printf("eval_line_parallel: pthread_create failed: %s\n", strerror(err));
+                /* still wait for workers already started */
+                break;
+            }
+        }
+
+        while( j-- ){
+            pthread_join(threads[j], 0);
+        }
+
+        if( err ){
+            goto EXIT;
+        }
+
+        /* running sum over chunks in file order */
+        for( j = 0; j < p->jobs; ++j ){
+            if( chunks[j].error ){
+                printf("eval_line_parallel: pread failed: %s\n", strerror(chunks[j].error));
+                goto EXIT;
+            }
+
+            /* rescan chunks holding target or a checkpoint the index lacks */
+            if(    observed + (long long int)chunks[j].count >= target
+                || (    p->index
+                     && observed / INDEX_INTERVAL + 1 == p->index->len
+                     && observed % INDEX_INTERVAL + chunks[j].count >= INDEX_INTERVAL )
+            ){
+                if( line_scan(p, chunks[j].buf, chunks[j].len, chunks[j].offset, &observed, target, &end) ){
+                    goto EXIT;
+                }
+
+                if( observed == target ){
+                    p->offset = chunks[j].offset + end;
+                    ret = 0;
+                    goto EXIT;
+                }
+            } else {
+                observed += chunks[j].count;
+            }
+
+            /* short chunk means end of file */
+            if( chunks[j].len < CHUNK_SIZE ){
+                puts("eval_line_parallel: reached end of file");
+                goto EXIT;
+            }
+        }
+
+        offset += (off_t)p->jobs * CHUNK_SIZE;
+    }
+
+EXIT:
+    p->engine->seek(p, p->offset);
+
+    return ret;
+}
+
+/* smallest read made by relative line motions
+ * reads double in size from here up to BLOCK_SIZE as a motion goes on,
+ * so short motions only touch a few KB around the cursor
+ */
+#define MIN_READ 4096
+
+/* find position just past the n-th newline at or after offset
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int line_forward(struct Program *p, off_t offset, long long int n, off_t *found){
+    char *block = 0;
+    const char *data = 0;
+    off_t size = MIN_READ;
+    size_t want = n;
+    size_t end = 0;
+    size_t nread = 0;
+
+    block = get_block(p);
+    if( ! block ){
+        puts("line_forward: call to get_block failed");
+        return 1;
+    }
+
+    /* reads end on a multiple of their size */
+    while( (data = p->engine->view(p, block, size - offset % size, offset, &nread)) && nread ){
+        end = scan_newlines(data, nread, &want);
+        if( ! want ){
+            *found = offset + end;
+            return 0;
+        }
+
+        offset += nread;
+        if( size < BLOCK_SIZE ){
+            size *= 2;
+        }
+    }
+
+    return 1;
+}
+
+/* find position just past the n-th newline before end, searching backwards
+ * the start of file stands in for the newline before line 1
+ * reads are made in blocks walking back from end
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int line_back(struct Program *p, off_t end, long long int n, off_t *found){
+    char *block = 0;
+    const char *data = 0;
+    off_t size = MIN_READ;
+    off_t start = 0;
+    size_t count = 0;
+    size_t want = 0;
+    size_t nread = 0;
+
+    block = get_block(p);
+    if( ! block ){
+        puts("line_back: call to get_block failed");
+        return 1;
+    }
+
+    while( end > 0 ){
+        /* block starts on a multiple of its size */
+        start = (end - 1) / size * size;
+
+        data = p->engine->view(p, block, end - start, start, &nread);
+        if( ! data || nread != end - start ){
+            puts("line_back: read failed");
+            return 1;
+        }
+
+        want = (size_t)-1;
+        scan_newlines(data, nread, &want);
+        count = (size_t)-1 - want;
+
+        if( count >= n ){
+            /* n-th newline from the end of block is (count - n + 1)-th from its start */
+            want = count - n + 1;
+            *found = start + scan_newlines(data, nread, &want);
+            return 0;
+        }
+
+        n -= count;
+        end = start;
+        if( size < BLOCK_SIZE ){
+            size *= 2;
+        }
+    }
+
+    /* start of file */
+    if( n == 1 ){
+        *found = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* eval LINE command relative to cursor
+ *
+ *  l+3
+ *  l-2
+ *
+ * l+0 and l-0 move to the start of the line holding the cursor
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int eval_line_relative(struct Program *p, struct Instruction *cur){
+    long long int num = cur->argument.num;
+    off_t found = 0;
+    int ret = 0;
+
+    if( num > 0 ){
+        ret = line_forward(p, p->offset, num, &found);
+    } else {
+        /* +1 for the newline ending the line before the cursor's */
+        ret = line_back(p, p->offset, 1 - num, &found);
+    }
+
+    if( ret ){
+        printf("eval_line: unable to move %lld lines from cursor\n", num);
+    } else {
+        p->offset = found;
+    }
+
+    p->engine->seek(p, p->offset);
+
+    return ret;
+}
+
+/* eval LINE command relative to end of file
+ *
+ *  l$
+ *  l$-4
+ *
+ * a trailing newline ends the last line rather than starting another
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int eval_line_end(struct Program *p, struct Instruction *cur){
+    long long int num = cur->argument.num;
+    off_t end = 0;
+    off_t found = 0;
+    const char *last = 0;
+    size_t nr = 0;
+    int ret = 0;
+
+    end = p->engine->size(p);
+    if( end < 0 ){
+        puts("eval_line_end: unable to find end of file");
+        return 1;
+    }
+
+    /* step back over trailing newline */
+    if( end > 0 ){
+        last = p->engine->view(p, 0, 1, end - 1, &nr);
+        if( ! last || nr != 1 ){
+            puts("eval_line_end: failed to read end of file");
+            return 1;
+        }
+        if( *last == '\n' ){
+            --end;
+        }
+    }
+
+    ret = line_back(p, end, 1 - num, &found);
+
+    if( ret ){
+        printf("eval_line: file has fewer than %lld lines\n", 1 - num);
+    } else {
+        p->offset = found;
+    }
+
+    p->engine->seek(p, p->offset);
+
+    return ret;
+}
+
+/* eval LINE command
+ * move cursor to start of specified line
+ *
+ *  l12
+ *
+ * relative forms are handed to eval_line_relative and eval_line_end
+ *
+ * scanning starts from the nearest preceding checkpoint in the line index
+ * if one is in use, otherwise from the start of file
+ *
+ * uses cur->argument.num
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_line(struct Program *p, struct Instruction *cur){
+    char *block = 0;
+    const char *data = 0;
+    /* number of newlines before requested line */
+    long long int target = cur->argument.num - 1;
+    long long int observed = 0;
+    size_t checkpoint = 0;
+    size_t end = 0;
+    size_t nread = 0;
+
+    switch( cur->argument.whence ){
+        case SEEK_CUR:
+            return eval_line_relative(p, cur);
+
+        case SEEK_END:
+            return eval_line_end(p, cur);
+    }
+
+    /* start from closest known checkpoint */
+    if( p->index ){
+        checkpoint = target / INDEX_INTERVAL;
+        if( checkpoint >= p->index->len ){
+            checkpoint = p->index->len - 1;
+        }
+        observed = checkpoint * INDEX_INTERVAL;
+        p->offset = p->index->checkpoints[checkpoint];
+    } else {
+        p->offset = 0;
+    }
+
+    /* nothing more to be done if we are already at requested line */
+    if( observed == target ){
+        p->engine->seek(p, p->offset);
+        return 0;
+    }
+
+    if( p->jobs > 1 ){
+        if( eval_line_parallel(p, observed, target) ){
+            printf("eval_line: failed before reaching line %lld\n", cur->argument.num);
+            return 1;
+        }
+        return 0;
+    }
+
+    block = get_block(p);
+    if( ! block ){
+        puts("eval_line: call to get_block failed");
+        return 1;
+    }
+
+    /* first read is short so that later reads are block aligned within file */
+    while( (data = p->engine->view(p, block, BLOCK_SIZE - p->offset % BLOCK_SIZE, p->offset, &nread)) && nread ){
+        if( line_scan(p, data, nread, p->offset, &observed, target, &end) ){
+            return 1;
+        }
+
+        if( observed == target ){
+            p->offset += end;
+            p->engine->seek(p, p->offset);
+            return 0;
+        }
+
+        p->offset += nread;
+    }
+
+    printf("eval_line: read error before reaching line %lld\n", cur->argument.num);
+    return 1;
+}
+
+/* eval SEARCH command
+ * move cursor to the start of the first match of string at or after cursor
+ * throws error if there is no match
+ *
+ *  /hello/
+ *
+ * file is read in blocks which overlap by one byte less than the string,
+ * so matches straddling the end of a block are found in the next one
+ *
+ * uses cur->argument.str
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_search(struct Program *p, struct Instruction *cur){
+    struct Needle needle;
+    size_t len = cur->argument.num;
+    /* where next block is read from */
+    off_t offset = p->offset;
+    /* size of blocks and buffer to read them into */
+    size_t size = BLOCK_SIZE;
+    char *buf = 0;
+    const char *data = 0;
+    size_t nr = 0;
+    size_t at = 0;
+
+    scan_needle(&needle, cur->argument.str, len);
+
+    /* blocks must hold more than one string's worth to make progress */
+    if( 2 * len > size ){
+        size = 2 * len;
+    } else {
+        buf = get_block(p);
+        if( ! buf ){
+            puts("eval_search: call to get_block failed");
+            return 1;
+        }
+    }
+
+    while( (data = p->engine->view(p, buf, size, offset, &nr)) && nr >= len ){
+        at = scan_find(&needle, data, nr);
+        if( at != SCAN_NONE ){
+            p->offset = offset + at;
+            p->engine->seek(p, p->offset);
+            return 0;
+        }
+
+        /* short read means end of file */
+        if( nr < size ){
+            break;
+        }
+
+        offset += nr - (len - 1);
+    }
+
+    if( data ){
+        printf("eval_search: no match for '%.*s' after cursor\n", (int)len, cur->argument.str);
+    }
+
+    return 1;
+}
+
+/* eval SEARCH_BACK command
+ * move cursor to the start of the last match of string before cursor
+ * throws error if there is no match
+ *
+ *  ?hello?
+ *
+ * as eval_search but blocks are read walking back from the cursor,
+ * a match may run past the cursor as long as it starts before it
+ *
+ * uses cur->argument.str
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_search_back(struct Program *p, struct Instruction *cur){
+    struct Needle needle;
+    size_t len = cur->argument.num;
+    /* block covers [start, end), start is the cursor until the first is read */
+    off_t end = p->offset + (off_t)(len - 1);
+    off_t start = p->offset;
+    /* size of blocks and buffer to read them into */
+    size_t size = BLOCK_SIZE;
+    char *buf = 0;
+    const char *data = 0;
+    size_t nr = 0;
+    size_t at = 0;
+
+    scan_needle(&needle, cur->argument.str, len);
+
+    /* blocks must hold more than one string's worth to make progress */
+    if( 2 * len > size ){
+        size = 2 * len;
+    } else {
+        buf = get_block(p);
+        if( ! buf ){
+            puts("eval_search_back: call to get_block failed");
+            return 1;
+        }
+    }
+
+    while( start > 0 ){
+        start = end > (off_t)size ? end - (off_t)size : 0;
+
+        /* may come up short if the block runs past end of file */
+        data = p->engine->view(p, buf, end - start, start, &nr);
+        if( ! data ){
+            return 1;
+        }
+
+        at = scan_find_last(&needle, data, nr);
+        if( at != SCAN_NONE ){
+            p->offset = start + at;
+            p->engine->seek(p, p->offset);
+            return 0;
+        }
+
+        end = start + (off_t)(len - 1);
+    }
+
+    printf("eval_search_back: no match for '%.*s' before cursor\n", (int)len, cur->argument.str);
+    return 1;
+}
+
+/* sets *boundary to 1 if the byte at offset is a newline or outside the file
+ * which is where '^' and '$' match
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int line_boundary(struct Program *p, off_t offset, int *boundary){
+    const char *data = 0;
+    char c = 0;
+    size_t nr = 0;
+
+    if( offset < 0 ){
+        *boundary = 1;
+        return 0;
+    }
+
+    data = p->engine->view(p, &c, 1, offset, &nr);
+    if( ! data ){
+        return 1;
+    }
+
+    *boundary = nr == 0 || data[0] == '\n';
+    return 0;
+}
+
+/* eval REGEX command
+ * move cursor to the start of the first match of pattern at or after cursor
+ * throws error if there is no match
+ *
+ *  r/^INSERT INTO `t[0-9]+`/
+ *
+ * the dfa runs forward a block at a time, carrying its state across blocks,
+ * until the earliest point a match ends, then backward from there to find
+ * where the longest match ending at that point starts
+ * neither pass backtracks so each byte is looked at most twice
+ *
+ * uses cur->argument.dfa
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_regex(struct Program *p, struct Instruction *cur){
+    struct DfaRun run;
+    /* where next block is read from, or up to going backward */
+    off_t offset = 0;
+    /* where the match ends */
+    off_t end = 0;
+    size_t want = 0;
+    char *buf = 0;
+    const char *data = 0;
+    size_t nr = 0;
+    /* cursor is at start of line */
+    int bol = 0;
+    int boundary = 0;
+    int ret = 0;
+
+    buf = get_block(p);
+    if( ! buf ){
+        puts("eval_regex: call to get_block failed");
+        return 1;
+    }
+
+    if( line_boundary(p, p->offset - 1, &bol) ){
+        return 1;
+    }
+
+    if( dfa_begin(&run, cur->argument.dfa, 0, bol) ){
+        puts("eval_regex: call to dfa_begin failed");
+        return 1;
+    }
+
+    for( offset = p->offset; ; offset += nr ){
+        data = p->engine->view(p, buf, BLOCK_SIZE, offset, &nr);
+        if( ! data ){
+            return 1;
+        }
+
+        ret = dfa_scan(&run, data, nr);
+        if( ret == -1 ){
+            puts("eval_regex: call to dfa_scan failed");
+            return 1;
+        }
+        if( ret != DFA_MORE ){
+            break;
+        }
+
+        /* short read means end of file */
+        if( nr < BLOCK_SIZE ){
+            dfa_finish(&run, 1);
+            break;
+        }
+    }
+
+    if( run.match == DFA_NONE ){
+        printf("eval_regex: no match for '%.*s' after cursor\n", (int)cur->argument.num, cur->argument.str);
+        return 1;
+    }
+
+    end = p->offset + (off_t)run.match;
+
+    /* now backward from end, for '$' the byte past the match is behind */
+    if( line_boundary(p, end, &boundary) ){
+        return 1;
+    }
+
+    if( dfa_begin(&run, cur->argument.dfa, 1, boundary) ){
+        puts("eval_regex: call to dfa_begin failed");
+        return 1;
+    }
+
+    ret = DFA_MORE;
+    for( offset = end; offset > p->offset && ret == DFA_MORE; offset -= want ){
+        want = offset - p->offset > BLOCK_SIZE ? BLOCK_SIZE : (size_t)(offset - p->offset);
+        data = p->engine->view(p, buf, want, offset - want, &nr);
+        if( ! data ){
+            return 1;
+        }
+        if( nr < want ){
+            puts("eval_regex: file shrank while searching");
+            return 1;
+        }
+
+        ret = dfa_scan(&run, data, nr);
+        if( ret == -1 ){
+            puts("eval_regex: call to dfa_scan failed");
+            return 1;
+        }
+    }
+
+    /* ran all the way back to the cursor */
+    if( ret == DFA_MORE ){
+        dfa_finish(&run, bol);
+    }
+
+    /* the forward pass only ends on a match which starts at or after cursor */
+    if( run.match == DFA_NONE ){
+        puts("eval_regex: lost track of match start");
+        return 1;
+    }
+
+    p->offset = end - (off_t)run.match;
+    p->engine->seek(p, p->offset);
+    return 0;
+}
+
+/* eval EXPECT command
+ * check current location matches specified string
+ * throws error if string does not match
+ *
+ *  e/hello/
+ *
+ * uses cur->argument.str
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_expect(struct Program *p, struct Instruction *cur){
+    /* string to compare to, shared with batch workers so never written */
+    const char *str = 0;
+    /* length of string */
+    size_t len = 0;
+    /* file contents at cursor */
+    const char *buf = 0;
+    /* num bytes read */
+    size_t nr = 0;
+
+    str = cur->argument.str;
+    if( ! str ){
+        puts("eval_expect: no string argument found");
+        return 1;
+    }
+
+    len = cur->argument.num;
+
+    /* perform read, of the file as edited so far */
+    if( p->pending.len ){
+        buf = edit_view(p, len, p->offset, &nr);
+    } else {
+        buf = p->engine->view(p, 0, len, p->offset, &nr);
+    }
+    if( ! buf ){
+        puts("eval_expect: failed to read file");
+        return 1;
+    }
+
+    /* compare number read to expected len */
+    if( nr != len ){
+        /* FIXME consider output when expect fails */
+        printf("eval_expect: expected to read '%zu' bytes, actually read '%zu'\n", len, nr);
+        return 1;
+    }
+
+    /* compare read string to expected str */
+    if( memcmp(str, buf, len) ){
+        /* FIXME consider output when expect fails */
+        printf("eval_expect: expected string '%.*s', got '%.*s'\n", (int)len, str, (int)nr, buf);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* a checksum over fewer bytes than this is never split between workers */
+#define CHECKSUM_PARALLEL (2 * CHUNK_SIZE)
+
+/* one worker's share of a parallel checksum */
+struct Digest {
+    /* file descriptor to pread from, and whether it is open O_DIRECT */
+    int fd;
+    int direct;
+    /* worker checksums [lo, hi) */
+    off_t lo;
+    off_t hi;
+    /* buffer of CHUNK_SIZE bytes */
+    char *buf;
+    unsigned int crc;
+    /* errno of failed read, 0 on success */
+    int error;
+};
+
+/* worker thread for checksum
+ * only reads through pread, which every engine's writes are visible to
+ */
+void * checksum_worker(void *arg){
+    struct Digest *digest = arg;
+    off_t offset = digest->lo;
+    size_t want = 0;
+    ssize_t nr = 0;
+
+    digest->crc = 0;
+    digest->error = 0;
+
+    while( offset < digest->hi ){
+        want = digest->hi - offset < CHUNK_SIZE ? digest->hi - offset : CHUNK_SIZE;
+        nr = pread_full(digest->fd, digest->direct, digest->buf, want, offset);
+        if( nr <= 0 ){
+            /* the range was measured against the file, so it ending early is an error too */
+            digest->error = nr ? errno : EIO;
+            return 0;
+        }
+        digest->crc = hash_crc32c(digest->crc, digest->buf, nr);
+        offset += nr;
+    }
+
+    return 0;
+}
+
+/* crc32c of [lo, hi) split between p->jobs workers
+ * each checksums its share, the shares are then combined in order
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int checksum_parallel(struct Program *p, off_t lo, off_t hi, unsigned int *crc){
+    struct Digest digests[MAX_JOBS];
+    pthread_t threads[MAX_JOBS];
+    off_t step = (hi - lo + p->jobs - 1) / p->jobs;
+    int err = 0;
+    int j = 0;
+
+    if( ! get_chunks(p) ){
+        return 1;
+    }
+
+    /* workers pread the file, so writes an engine still has under way must land first */
+    if( p->engine->flush(p) ){
+        puts("checksum_parallel: failed to finish writes");
+        return 1;
+    }
+
+    /* settle on a hash kernel before workers race to */
+    hash_kernel();
+
+    for( j = 0; j < p->jobs; ++j ){
+        digests[j].fd = p->fd;
+        digests[j].direct = p->direct;
+        digests[j].lo = lo + (off_t)j * step < hi ? lo + (off_t)j * step : hi;
+        digests[j].hi = digests[j].lo + step < hi ? digests[j].lo + step : hi;
+        digests[j].buf = p->chunks + (size_t)j * CHUNK_STRIDE;
+    }
+
+    for( j = 0; j < p->jobs; ++j ){
+        err = pthread_create(&threads[j], 0, checksum_worker, &digests[j]);
+        if( err ){
+            printf("checksum_parallel: pthread_create failed: %s\n", strerror(err));
+            /* still wait for workers already started */
+            break;
+        }
+    }
+
+    while( j-- ){
+        pthread_join(threads[j], 0);
+    }
+
+    if( err ){
+        return 1;
+    }
+
+    *crc = 0;
+    for( j = 0; j < p->jobs; ++j ){
+        if( digests[j].error ){
+            printf("checksum_parallel: worker failed to read: %s\n", strerror(digests[j].error));
+            return 1;
+        }
+        *crc = hash_combine(*crc, digests[j].crc, digests[j].hi - digests[j].lo);
+    }
+
+    return 0;
+}
+
+/* crc32c of count bytes at cursor, or up to end of file if count is -1
+ * fewer bytes are checksummed if the file ends first, *len is set to how many
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int checksum(struct Program *p, long long int count, unsigned int *crc, long long int *len){
+    const char *data = 0;
+    char *block = 0;
+    off_t size = 0;
+    off_t end = 0;
+    off_t offset = 0;
+    size_t want = 0;
+    size_t nr = 0;
+
+    size = p->engine->size(p);
+    if( size == -1 ){
+        puts("checksum: failed to get size of file");
+        return 1;
+    }
+
+    end = count == -1 || count > size - p->offset ? size : p->offset + count;
+    *len = end > p->offset ? end - p->offset : 0;
+    *crc = 0;
+
+    if( p->jobs > 1 && *len >= CHECKSUM_PARALLEL ){
+        return checksum_parallel(p, p->offset, end, crc);
+    }
+
+    block = get_block(p);
+    if( ! block ){
+        puts("checksum: call to get_block failed");
+        return 1;
+    }
+
+    for( offset = p->offset; offset < end; offset += nr ){
+        want = end - offset < BLOCK_SIZE ? end - offset : BLOCK_SIZE;
+        data = p->engine->view(p, block, want, offset, &nr);
+        if( ! data || ! nr ){
+            puts("checksum: failed to read file");
+            return 1;
+        }
+        *crc = hash_crc32c(*crc, data, nr);
+    }
+
+    return 0;
+}
+
+/* eval HASH command
+ * print crc32c of specified number of bytes, or of the rest of the file
+ * printed as the EXPECT_HASH command that would check it
+ *
+ *  h
+ *  h1048576
+ *
+ * prints
+ *
+ *  e#8bd50d14#1048576
+ *
+ * uses cur->argument.count
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_hash(struct Program *p, struct Instruction *cur){
+    unsigned int crc = 0;
+    long long int len = 0;
+
+    if( checksum(p, cur->argument.count, &crc, &len) ){
+        puts("eval_hash: call to checksum failed");
+        return 1;
+    }
+
+    printf("e#%08x#%lld\n", crc, len);
+
+    return 0;
+}
+
+/* eval EXPECT_HASH command
+ * check crc32c of specified number of bytes, or of the rest of the file
+ * throws error if it does not match, or the file ends first
+ *
+ *  e#8bd50d14#1048576
+ *
+ * uses cur->argument.num and cur->argument.count
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_expect_hash(struct Program *p, struct Instruction *cur){
+    unsigned int crc = 0;
+    long long int len = 0;
+
+    if( checksum(p, cur->argument.count, &crc, &len) ){
+        puts("eval_expect_hash: call to checksum failed");
+        return 1;
+    }
+
+    if( cur->argument.count != -1 && len != cur->argument.count ){
+        printf("eval_expect_hash: expected to hash '%lld' bytes, actually hashed '%lld'\n", cur->argument.count, len);
+        return 1;
+    }
+
+    if( crc != (unsigned int)cur->argument.num ){
+        printf("eval_expect_hash: expected crc32c '%08x', got '%08x'\n", (unsigned int)cur->argument.num, crc);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* eval WRITE command
+ * write specified string
+ * will overwrite existing text in place
+ *
+ *  w/world/
+ *
+ * uses cur->argument.str
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_write(struct Program *p, struct Instruction *cur){
+    /* string to write */
+    char *str = 0;
+    /* len of str */
+    size_t len = 0;
+    /* number of bytes written */
+    size_t nw = 0;
+    /* length of file as edited so far */
+    off_t size = 0;
+
+    str = cur->argument.str;
+    if( ! str ){
+        puts("eval_write: no argument string found");
+        return 1;
+    }
+
+    len = cur->argument.num;
+
+    size = edit_size(p);
+    if( size == -1 ){
+        return 1;
+    }
+
+    /* a write within the edited file joins the pending edits,
+     * merging with any it runs on from or over
+     */
+    if( p->offset <= size ){
+        if(    edit_room(p)
+            || edit_splice(p, p->offset, size - p->offset < (off_t)len ? size - p->offset : (off_t)len, str, len)
+        ){
+            return 1;
+        }
+        p->offset += len;
+        p->engine->seek(p, p->offset);
+        return 0;
+    }
+
+    /* writing past the end leaves a hole, do that on the file itself */
+    if( edit_apply(p) ){
+        puts("eval_write: failed to apply pending edits");
+        return 1;
+    }
+
+    if( p->index && index_write(p, str, len, p->offset) ){
+        puts("eval_write: failed to update line index");
+        return 1;
+    }
+
+    /* perform write, and wait for it where the engine would not */
+    nw = p->engine->write(p, str, len, p->offset);
+    if( nw == len && p->engine->flush(p) ){
+        nw = 0;
+    }
+
+    /* check length */
+    if( nw != len ){
+        printf("eval_write: expected to write '%zu' bytes, actually wrote '%zu'\n", len, nw);
+        return 1;
+    }
+
+    /* update file offset to be at end of write */
+    p->offset += nw;
+    p->engine->seek(p, p->offset);
+
+    return 0;
+}
+
+/* eval WRITE_FILE command
+ * write contents of another file, or a byte range of it
+ * will overwrite existing text in place
+ *
+ *  f/payload.bin/
+ *  f/payload.bin/4096,512
+ *
+ * the engine copies the bytes from file to file without reading them,
+ * pending edits have already been applied as this is not deferrable
+ *
+ * uses cur->argument.str, cur->argument.from and cur->argument.count
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_write_file(struct Program *p, struct Instruction *cur){
+    /* cur->argument.str as a string */
+    char *path = 0;
+    struct stat st;
+    struct stat target;
+    off_t from = 0;
+    off_t len = 0;
+    /* number of bytes copied */
+    size_t nw = 0;
+    int fd = -1;
+    int ret = 1;
+
+    if( ! cur->argument.str ){
+        puts("eval_write_file: no argument string found");
+        return 1;
+    }
+
+    path = malloc(cur->argument.num + 1);
+    if( ! path ){
+        puts("eval_write_file: call to malloc failed");
+        return 1;
+    }
+    memcpy(path, cur->argument.str, cur->argument.num);
+    path[cur->argument.num] = '\0';
+
+    fd = open(path, O_RDONLY);
+    if( fd == -1 ){
+        printf("eval_write_file: failed to open '%s'\n", path);
+        goto EXIT;
+    }
+
+    if( fstat(fd, &st) || fstat(p->fd, &target) ){
+        perror("eval_write_file: error in call to fstat");
+        goto EXIT;
+    }
+
+    from = cur->argument.from;
+    len = cur->argument.count == -1 ? st.st_size - from : cur->argument.count;
+    if( from > st.st_size || len > st.st_size - from ){
+        printf("eval_write_file: '%s' is only %lld bytes long\n", path, (long long int)st.st_size);
+        goto EXIT;
+    }
+
+    /* copying a file over itself is only well defined where it does not overlap */
+    if(    st.st_dev == target.st_dev && st.st_ino == target.st_ino
+        && from < p->offset + len && p->offset < from + len
+    ){
+        printf("eval_write_file: '%s' would be copied over itself\n", path);
+        goto EXIT;
+    }
+
+    /* newlines copied in are not seen, so checkpoints past here cannot stand */
+    if( p->index ){
+        index_invalidate(p->index, p->offset);
+    }
+
+    nw = p->engine->copy(p, fd, from, len, p->offset);
+    if( nw != (size_t)len ){
+        printf("eval_write_file: expected to copy '%lld' bytes, actually copied '%zu'\n", (long long int)len, nw);
+        goto EXIT;
+    }
+
+    /* update file offset to be at end of copy */
+    p->offset += nw;
+    p->engine->seek(p, p->offset);
+
+    ret = 0;
+
+EXIT:
+    if( fd != -1 ){
+        close(fd);
+    }
+    free(path);
+    return ret;
+}
+
+/* replaces matches of needle lying wholly within data[0, len) with replace,
+ * left to right without overlaps, into out which must hold len bytes
+ * data is copied into out on the first match unless they are the same buffer
+ *
+ * sets *first and *last to the span of out changed, if anything was
+ * sets *resume to where in data the next block should start
+ *
+ * returns number of matches replaced
+ */
+size_t subst_block(const struct Needle *needle, const char *replace, const char *data, char *out, size_t len, size_t *first, size_t *last, size_t *resume){
+    size_t count = 0;
+    size_t at = 0;
+    size_t i = 0;
+
+    while( i + needle->len <= len && (at = scan_find(needle, data + i, len - i)) != SCAN_NONE ){
+        at += i;
+        if( ! count ){
+            if( out != data ){
+                memcpy(out, data, len);
+            }
+            *first = at;
+        }
+
+        /* data is only searched past here, so overwriting it is fine */
+        memcpy(out + at, replace, needle->len);
+        ++count;
+
+        i = at + needle->len;
+        *last = i;
+    }
+
+    /* a match may straddle the end, so the next block overlaps this one */
+    *resume = len >= needle->len ? len - needle->len + 1 : 0;
+    if( *resume < i ){
+        *resume = i;
+    }
+
+    return count;
+}
+
+/* one worker's share of a parallel substitution */
+struct Share {
+    struct Program *p;
+    const struct Needle *needle;
+    const char *replace;
+    /* worker replaces matches lying wholly within [lo, hi) */
+    off_t lo;
+    off_t hi;
+    /* buffer of CHUNK_SIZE bytes */
+    char *buf;
+    long long int count;
+    long long int bytes;
+    /* offset of first match, -1 if there was none */
+    off_t first;
+    /* set if a read or write failed */
+    int error;
+};
+
+/* worker thread for eval_substitute
+ * only uses pread_view and pread_write, which touch nothing but p->fd,
+ * so every worker can share p whichever engine is active
+ */
+void * subst_worker(void *arg){
+    struct Share *share = arg;
+    off_t offset = share->lo;
+    size_t want = 0;
+    size_t nr = 0;
+    size_t count = 0;
+    size_t first = 0;
+    size_t last = 0;
+    size_t resume = 0;
+
+    share->count = 0;
+    share->bytes = 0;
+    share->first = -1;
+    share->error = 0;
+
+    while( offset < share->hi ){
+        want = share->hi - offset < CHUNK_SIZE ? (size_t)(share->hi - offset) : CHUNK_SIZE;
+        if( ! pread_view(share->p, share->buf, want, offset, &nr) ){
+            share->error = 1;
+            return 0;
+        }
+
+        count = subst_block(share->needle, share->replace, share->buf, share->buf, nr, &first, &last, &resume);
+        if( count ){
+            if( pread_write(share->p, share->buf + first, last - first, offset + first) != last - first ){
+                share->error = 1;
+                return 0;
+            }
+            if( share->first == -1 ){
+                share->first = offset + first;
+            }
+            share->count += count;
+            share->bytes += last - first;
+        }
+
+        /* short read means end of file */
+        if( nr < want || offset + (off_t)nr >= share->hi ){
+            break;
+        }
+
+        offset += resume;
+    }
+
+    return 0;
+}
+
+/* returns 1 if two occurrences of str could overlap, as "aa" can in "aaa" */
+int self_overlapping(const char *str, size_t len){
+    size_t k = 0;
+
+    for( k = 1; k < len; ++k ){
+        if( ! memcmp(str, str + k, len - k) ){
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* splits [0, size) between p->jobs workers
+ * each replaces the matches lying wholly in its share, matches straddling
+ * two shares are found before the workers start and replaced after they end,
+ * so no worker reads bytes another may be writing
+ *
+ * only used for strings which cannot overlap themselves, every occurrence is
+ * then a match and it doesn't matter where the scan for one starts
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int subst_parallel(struct Program *p, const struct Needle *needle, const char *replace, off_t size,
+                   long long int *count, long long int *bytes, off_t *first){
+    struct Share shares[MAX_JOBS];
+    pthread_t threads[MAX_JOBS];
+    /* offset of match straddling start of each share, -1 if none */
+    off_t straddle[MAX_JOBS];
+    off_t step = (size + p->jobs - 1) / p->jobs;
+    off_t lo = 0;
+    size_t len = needle->len;
+    const char *data = 0;
+    size_t nr = 0;
+    size_t at = 0;
+    int err = 0;
+    int j = 0;
+
+    if( ! get_chunks(p) ){
+        return 1;
+    }
+
+    /* workers pread the file, so writes an engine still has under way must land first */
+    if( p->engine->flush(p) ){
+        puts("subst_parallel: failed to finish writes");
+        return 1;
+    }
+
+    /* settle on a scan kernel before workers race to */
+    scan_kernel();
+
+    for( j = 0; j < p->jobs; ++j ){
+        shares[j].p = p;
+        shares[j].needle = needle;
+        shares[j].replace = replace;
+        shares[j].lo = (off_t)j * step;
+        shares[j].hi = shares[j].lo + step < size ? shares[j].lo + step : size;
+        shares[j].buf = p->chunks + (size_t)j * CHUNK_STRIDE;
+        straddle[j] = -1;
+
+        /* any occurrence within len - 1 bytes either side of lo straddles it */
+        if( j ){
+            lo = shares[j].lo - (off_t)(len - 1);
+            data = p->engine->view(p, 0, 2 * (len - 1), lo, &nr);
+            if( ! data ){
+                return 1;
+            }
+            at = scan_find(needle, data, nr);
+            if( at != SCAN_NONE ){
+                straddle[j] = lo + at;
+            }
+        }
+    }
+
+    for( j = 0; j < p->jobs; ++j ){
+        err = pthread_create(&threads[j], 0, subst_worker, &shares[j]);
+        if( err ){
+            printf("subst_parallel: pthread_create failed: %s\n", strerror(err));
+            /* still wait for workers already started */
+            break;
+        }
+    }
+
+    while( j-- ){
+        pthread_join(threads[j], 0);
+    }
+
+#ifdef __linux__
+    /* workers wrote around the ring, so reads it holds may be of the old bytes */
+    if( p->uring ){
+        uring_forget(p, 0, size);
+    }
+#endif
+
+    if( err ){
+        return 1;
+    }
+
+    for( j = 0; j < p->jobs; ++j ){
+        if( shares[j].error ){
+            puts("subst_parallel: worker failed");
+            return 1;
+        }
+
+        if( straddle[j] != -1 ){
+            if( p->engine->write(p, replace, len, straddle[j]) != len ){
+                puts("subst_parallel: failed to write replacement");
+                return 1;
+            }
+            if( *first == -1 ){
+                *first = straddle[j];
+            }
+            *count += 1;
+            *bytes += len;
+        }
+
+        if( shares[j].count ){
+            if( *first == -1 ){
+                *first = shares[j].first;
+            }
+            *count += shares[j].count;
+            *bytes += shares[j].bytes;
+        }
+    }
+
+    return 0;
+}
+
+/* eval SUBSTITUTE command
+ * replace every occurrence of string in the file with a string of the same length
+ * occurrences are taken left to right without overlapping, as sed does
+ *
+ *  s/INSERT/UPSERT/g
+ *
+ * file is read in one pass of blocks which overlap by one byte less than
+ * the string, only the span of each block which changed is written back
+ * with more than one job, files of a couple of chunks and up are split
+ * between workers instead
+ *
+ * prints the number of matches and bytes rewritten
+ * the cursor is left where it was
+ *
+ * uses cur->argument.str and cur->argument.replace
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_substitute(struct Program *p, struct Instruction *cur){
+    struct Needle needle;
+    size_t len = cur->argument.num;
+    const char *replace = cur->argument.replace;
+    /* where next block is read from */
+    off_t offset = 0;
+    off_t size = 0;
+    /* size of blocks and buffer to patch them in */
+    size_t block = BLOCK_SIZE;
+    char *buf = 0;
+    const char *data = 0;
+    size_t nr = 0;
+    size_t count = 0;
+    size_t first = 0;
+    size_t last = 0;
+    size_t resume = 0;
+    long long int matches = 0;
+    long long int bytes = 0;
+    /* offset of first match, -1 if none */
+    off_t changed = -1;
+    size_t i = 0;
+
+    scan_needle(&needle, cur->argument.str, len);
+
+    size = p->engine->size(p);
+    if( size == -1 ){
+        return 1;
+    }
+
+    /* workers read and write through pread_view and pread_write, which cannot be aligned */
+    if(    p->jobs > 1
+        && ! p->direct
+        && size >= 2 * CHUNK_SIZE
+        && 2 * (off_t)len <= size / p->jobs
+        && ! self_overlapping(cur->argument.str, len)
+    ){
+        if( subst_parallel(p, &needle, replace, size, &matches, &bytes, &changed) ){
+            return 1;
+        }
+        goto EXIT;
+    }
+
+    /* blocks must hold more than one string's worth to make progress */
+    if( 2 * len > block ){
+        block = 2 * len;
+        buf = get_buffer(p, block);
+    } else {
+        buf = get_block(p);
+    }
+    if( ! buf ){
+        puts("eval_substitute: failed to allocate buffer");
+        return 1;
+    }
+
+    while( (data = p->engine->view(p, buf, block, offset, &nr)) ){
+        count = subst_block(&needle, replace, data, buf, nr, &first, &last, &resume);
+        if( count ){
+            if( p->engine->write(p, buf + first, last - first, offset + first) != last - first ){
+                puts("eval_substitute: failed to write back block");
+                return 1;
+            }
+            if( changed == -1 ){
+                changed = offset + first;
+            }
+            matches += count;
+            bytes += last - first;
+        }
+
+        /* short read means end of file */
+        if( nr < block ){
+            break;
+        }
+
+        offset += resume;
+    }
+
+    if( ! data ){
+        return 1;
+    }
+
+EXIT:
+    /* newlines only move if string and replace have them in different places */
+    if( p->index && changed != -1 ){
+        for( i = 0; i < len; ++i ){
+            if( (cur->argument.str[i] == '\n') != (replace[i] == '\n') ){
+                index_invalidate(p->index, changed);
+                break;
+            }
+        }
+        p->index->dirty = 1;
+    }
+
+    printf("%lld matches, %lld bytes rewritten\n", matches, bytes);
+
+    /* the rewrites are done before any later command sees the file */
+    if( p->engine->flush(p) ){
+        puts("eval_substitute: failed to finish writes");
+        return 1;
+    }
+
+    p->engine->seek(p, p->offset);
+    return 0;
+}
+
+/* eval INSERT command
+ * insert string at cursor, moving everything after it along
+ *
+ *  i/hello/
+ *
+ * the insert is only recorded here, see edit_apply
+ * leaves the cursor after the inserted string
+ *
+ * uses cur->argument.str
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_insert(struct Program *p, struct Instruction *cur){
+    size_t len = cur->argument.num;
+    off_t size = 0;
+
+    size = edit_size(p);
+    if( size == -1 ){
+        return 1;
+    }
+
+    if( p->offset > size ){
+        printf("eval_insert: cursor '%lld' is beyond end of file\n", (long long int)p->offset);
+        return 1;
+    }
+
+    if( edit_room(p) || edit_splice(p, p->offset, 0, cur->argument.str, len) ){
+        puts("eval_insert: call to edit_splice failed");
+        return 1;
+    }
+
+    p->offset += len;
+    p->engine->seek(p, p->offset);
+
+    return 0;
+}
+
+/* eval DELETE command
+ * remove bytes at cursor, moving everything after them back
+ * stops at end of file
+ *
+ *  d5
+ *
+ * the delete is only recorded here, see edit_apply
+ * the cursor does not move
+ *
+ * uses cur->argument.num
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_delete(struct Program *p, struct Instruction *cur){
+    off_t num = cur->argument.num;
+    off_t size = 0;
+
+    /* default to 1 byte */
+    if( ! num ){
+        num = 1;
+    }
+
+    size = edit_size(p);
+    if( size == -1 ){
+        return 1;
+    }
+
+    if( p->offset >= size ){
+        return 0;
+    }
+
+    if( num > size - p->offset ){
+        num = size - p->offset;
+    }
+
+    if( edit_room(p) || edit_splice(p, p->offset, num, 0, 0) ){
+        puts("eval_delete: call to edit_splice failed");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* eval TRUNCATE command
+ * truncate file at cursor position
+ * returns 0 on success
+ * returns 1 on failure
+ * failure will cause program to halt
+ */
+int eval_truncate(struct Program *p, struct Instruction *cur){
+    if( p->engine->truncate(p, p->offset) ){
+        puts("eval_truncate: failed to truncate file");
+        return 1;
+    }
+
+    /* lines beyond cursor no longer exist */
+    if( p->index ){
+        index_invalidate(p->index, p->offset);
+    }
+
+    return 0;
+}
+
+/***** prefetch *****/
+
+/* byte ranges ahead of the instruction being run that the kernel is asked to read */
+#define PREFETCH_DEPTH 32
+/* most bytes asked for at once, the reads themselves trigger readahead past this */
+#define PREFETCH_MAX (4 << 20)
+
+struct Prefetch {
+    /* next instruction to look at */
+    size_t next;
+    /* cursor as it will be when next runs, if known */
+    off_t offset;
+    int known;
+    /* ranges asked for, oldest first, each with the last instruction touching it */
+    off_t start[PREFETCH_DEPTH];
+    off_t end[PREFETCH_DEPTH];
+    size_t order[PREFETCH_DEPTH];
+    size_t head;
+    size_t len;
+};
+
+void prefetch_init(struct Prefetch *f, struct Program *p){
+    f->next = 0;
+    f->offset = p->offset;
+    f->known = 1;
+    f->head = 0;
+    f->len = 0;
+}
+
+/* the kernel is told to start reading [start, end) now
+ * joining it to the newest range when they touch, so b e w over the same bytes is asked for once
+ */
+void prefetch_range(struct Program *p, struct Prefetch *f, off_t start, off_t end, size_t order){
+    size_t last = (f->head + f->len - 1) % PREFETCH_DEPTH;
+
+    if( end - start > PREFETCH_MAX ){
+        end = start + PREFETCH_MAX;
+    }
+
+    p->engine->fetch(p, start, end - start);
+
+    if( f->len && start <= f->end[last] && end >= f->start[last] ){
+        f->start[last] = start < f->start[last] ? start : f->start[last];
+        f->end[last] = end > f->end[last] ? end : f->end[last];
+        f->order[last] = order;
+        return;
+    }
+
+    last = (f->head + f->len) % PREFETCH_DEPTH;
+    f->start[last] = start;
+    f->end[last] = end;
+    f->order[last] = order;
+    ++f->len;
+}
+
+/* the oldest range is done with, so the kernel may drop its pages
+ * unless a range still to come shares them or edits not yet applied will rewrite them
+ * the kernel keeps pages only partly covered, so the range is widened to whole pages
+ */
+void prefetch_drop(struct Program *p, struct Prefetch *f){
+    off_t page = sysconf(_SC_PAGESIZE);
+    off_t start = f->start[f->head] - f->start[f->head] % page;
+    off_t end = f->end[f->head] + (page - f->end[f->head] % page) % page;
+    size_t k = 0;
+    size_t j = 0;
+
+    f->head = (f->head + 1) % PREFETCH_DEPTH;
+    --f->len;
+
+    if( p->pending.len ){
+        return;
+    }
+
+    for( k = 0; k < f->len; ++k ){
+        j = (f->head + k) % PREFETCH_DEPTH;
+        if( f->start[j] < end && f->end[j] > start ){
+            return;
+        }
+    }
+
+    posix_fadvise(p->fd, start, end - start, POSIX_FADV_DONTNEED);
+}
+
+/* called before the instruction at position now runs
+ * drops the ranges of instructions already run
+ * then follows the cursor through the instructions ahead as far as it can be foreseen,
+ * asking for the bytes each reads or writes, until PREFETCH_DEPTH ranges are outstanding
+ */
+void prefetch(struct Program *p, struct Prefetch *f, size_t now){
+    struct Instruction *i = 0;
+    long long int num = 0;
+
+    while( f->len && f->order[f->head] < now ){
+        prefetch_drop(p, f);
+    }
+
+    if( f->next < now ){
+        /* skipped over by the planner, the cursor is where it left it */
+        f->next = now;
+        f->offset = p->offset;
+        f->known = 1;
+    }
+
+    for( ; f->len < PREFETCH_DEPTH && f->next < p->code_len; ++f->next ){
+        i = &(p->code[f->next]);
+        num = i->argument.num;
+
+        switch( i->command ){
+            case BYTE:
+                f->offset = num;
+                f->known = 1;
+                break;
+
+            case PRINT:
+            case RAW:
+            case HEXDUMP:
+                if( f->known ){
+                    prefetch_range(p, f, f->offset, f->offset + (num ? num : 100), f->next);
+                }
+                break;
+
+            case EXPECT:
+                if( f->known && num ){
+                    prefetch_range(p, f, f->offset, f->offset + num, f->next);
+                }
+                break;
+
+            case HASH:
+            case EXPECT_HASH:
+                if( f->known && i->argument.count ){
+                    prefetch_range(p, f, f->offset,
+                                   i->argument.count == -1 ? f->offset + PREFETCH_MAX : f->offset + i->argument.count,
+                                   f->next);
+                }
+                break;
+
+            case WRITE:
+                /* a write over part of a page reads the rest of it */
+                if( f->known && num ){
+                    prefetch_range(p, f, f->offset, f->offset + num, f->next);
+                    f->offset += num;
+                }
+                break;
+
+            case SUBSTITUTE:
+            case TRUNCATE:
+                break;
+
+            case QUIT:
+                f->next = p->code_len;
+                return;
+
+            default:
+                /* line motions, searches and edits move the cursor in ways not known until they run */
+                f->known = 0;
+                break;
+        }
+    }
+}
+
+/* every range left is done with once the program stops */
+void prefetch_finish(struct Program *p, struct Prefetch *f){
+    while( f->len ){
+        prefetch_drop(p, f);
+    }
+}
+
+/***** verification *****/
+
+/* an e or w command whose offset is known before the program runs */
+struct VerifyOp {
+    struct Instruction *i;
+    /* cursor when it runs in order */
+    off_t offset;
+    /* position in program */
+    size_t order;
+    /* for expects, end of the furthest write before it in program order */
+    off_t reach;
+};
+
+/* by offset, then program order */
+int verify_compare_offset(const void *a, const void *b){
+    const struct VerifyOp *x = a;
+    const struct VerifyOp *y = b;
+
+    if( x->offset != y->offset ){
+        return x->offset < y->offset ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+int verify_compare_order(const void *a, const void *b){
+    const struct VerifyOp *x = a;
+    const struct VerifyOp *y = b;
+
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/* append op to *ops, growing it as needed
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int verify_push(struct VerifyOp **ops, size_t *len, size_t *cap, struct VerifyOp op){
+    struct VerifyOp *grown = 0;
+
+    if( *len == *cap ){
+        *cap = *cap ? 2 * *cap : 64;
+        grown = realloc(*ops, *cap * sizeof(**ops));
+        if( ! grown ){
+            puts("verify_push: call to realloc failed");
+            return 1;
+        }
+        *ops = grown;
+    }
+
+    (*ops)[(*len)++] = op;
+    return 0;
+}
+
+/* put together in buf the len bytes expect check will see at its offset
+ * from the bytes of the file at that offset, data[0, nr), and the writes
+ * before it in program order, writes[0, nwrites) sorted by offset
+ * with ends[k] the furthest end of writes[0, k]
+ * bytes past the end of the file that writes skipped over are a hole
+ *
+ * returns number of bytes the expect can read
+ */
+size_t verify_overlay(const struct VerifyOp *check, const char *data, size_t nr, off_t size,
+                      const struct VerifyOp *writes, const off_t *ends, size_t nwrites,
+                      struct VerifyOp *found, char *buf){
+    size_t len = check->i->argument.num;
+    off_t lo = check->offset;
+    off_t hi = lo + (off_t)len;
+    off_t from = 0;
+    off_t to = 0;
+    size_t nfound = 0;
+    size_t k = 0;
+
+    /* file as long as the furthest write so far made it */
+    if( check->reach > size ){
+        size = check->reach;
+    }
+    if( hi > size ){
+        hi = size > lo ? size : lo;
+        len = hi - lo;
+    }
+
+    /* data may already be in buf */
+    memmove(buf, data, nr < len ? nr : len);
+    if( nr < len ){
+        memset(buf + nr, 0, len - nr);
+    }
+
+    /* writes starting before hi, back to where none can reach lo */
+    for( k = nwrites; k > 0 && writes[k - 1].offset >= hi; --k ){
+    }
+    for( ; k > 0 && ends[k - 1] > lo; --k ){
+        if(    writes[k - 1].order < check->order
+            && writes[k - 1].offset + writes[k - 1].i->argument.num > lo
+        ){
+            found[nfound++] = writes[k - 1];
+        }
+    }
+
+    /* later writes land over earlier ones */
+    qsort(found, nfound, sizeof(*found), verify_compare_order);
+    for( k = 0; k < nfound; ++k ){
+        from = found[k].offset > lo ? found[k].offset : lo;
+        to = found[k].offset + found[k].i->argument.num < hi ? found[k].offset + found[k].i->argument.num : hi;
+        memcpy(buf + (from - lo), found[k].i->argument.str + (from - found[k].offset), to - from);
+    }
+
+    return len;
+}
+
+/* check every expect whose offset is known before the program runs,
+ * in one forward read over the file before anything is written
+ *
+ * the cursor is followed through b and w commands, and through the
+ * commands which do not move it, line seeks and searches leave it unknown
+ * until the next b, and expects are skipped while it is
+ * expects are compared against the file as the writes before them leave it,
+ * following the program stops at a write to an unknown offset, or at
+ * commands changing the file in other ways as those cannot be foreseen
+ *
+ * the expects still run with the program, but can then only fail
+ * if the file changes underneath it
+ *
+ * returns 0 if all of them match
+ * returns 1 on failure
+ */
+int verify(struct Program *p){
+    struct VerifyOp *checks = 0;
+    size_t nchecks = 0;
+    size_t checks_cap = 0;
+    struct VerifyOp *writes = 0;
+    size_t nwrites = 0;
+    size_t writes_cap = 0;
+    /* furthest end of writes[0, k] once sorted */
+    off_t *ends = 0;
+    /* writes overlapping the expect being checked */
+    struct VerifyOp *found = 0;
+    struct VerifyOp op;
+    struct Instruction *i = 0;
+    off_t offset = 0;
+    int known = 1;
+    off_t reach = 0;
+    off_t size = 0;
+    /* file bytes read forward through block, holding [base, base + nr) */
+    const char *window = 0;
+    char *block = 0;
+    off_t base = 0;
+    size_t nr = 0;
+    const char *data = 0;
+    size_t avail = 0;
+    char *buf = 0;
+    size_t len = 0;
+    size_t k = 0;
+    int ret = 1;
+
+    for( k = 0; k < p->code_len; ++k ){
+        i = &(p->code[k]);
+        op.i = i;
+        op.offset = offset;
+        op.order = k;
+        op.reach = reach;
+
+        switch( i->command ){
+            case BYTE:
+                offset = i->argument.num;
+                known = 1;
+                continue;
+
+            case EXPECT:
+                if( known && i->argument.num && verify_push(&checks, &nchecks, &checks_cap, op) ){
+                    goto EXIT;
+                }
+                continue;
+
+            case WRITE:
+                if( ! known ){
+                    break;
+                }
+                if( i->argument.num && verify_push(&writes, &nwrites, &writes_cap, op) ){
+                    goto EXIT;
+                }
+                offset += i->argument.num;
+                if( offset > reach ){
+                    reach = offset;
+                }
+                continue;
+
+            case PRINT:
+            case RAW:
+            case HEXDUMP:
+            case HASH:
+            case EXPECT_HASH:
+                continue;
+
+            case LINE:
+            case SEARCH:
+            case SEARCH_BACK:
+            case REGEX:
+                known = 0;
+                continue;
+
+            default:
+                break;
+        }
+
+        /* nothing past here can be foreseen */
+        break;
+    }
+
+    if( ! nchecks ){
+        ret = 0;
+        goto EXIT;
+    }
+
+    qsort(checks, nchecks, sizeof(*checks), verify_compare_offset);
+    qsort(writes, nwrites, sizeof(*writes), verify_compare_offset);
+
+    ends = malloc((nwrites ? nwrites : 1) * sizeof(*ends));
+    found = malloc((nwrites ? nwrites : 1) * sizeof(*found));
+    block = get_block(p);
+    if( ! ends || ! found || ! block ){
+        puts("verify: failed to allocate buffers");
+        goto EXIT;
+    }
+    for( k = 0; k < nwrites; ++k ){
+        ends[k] = writes[k].offset + writes[k].i->argument.num;
+        if( k && ends[k - 1] > ends[k] ){
+            ends[k] = ends[k - 1];
+        }
+    }
+
+    size = p->engine->size(p);
+    if( size == -1 ){
+        puts("verify: failed to get size of file");
+        goto EXIT;
+    }
+
+    for( k = 0; k < nchecks; ++k ){
+        len = checks[k].i->argument.num;
+
+        /* 1 + len as a failing expect is printed as a string */
+        buf = get_buffer(p, 1 + len);
+        if( ! buf ){
+            goto EXIT;
+        }
+
+        /* the window moves forward a block at a time,
+         * expects longer than a block are read on their own
+         */
+        if( len > BLOCK_SIZE ){
+            data = p->engine->view(p, buf, len, checks[k].offset, &avail);
+        } else {
+            if(    ! window
+                || checks[k].offset < base
+                || checks[k].offset + (off_t)len > base + (off_t)nr
+            ){
+                base = checks[k].offset;
+                window = p->engine->view(p, block, BLOCK_SIZE, base, &nr);
+                if( ! window ){
+                    puts("verify: failed to read file");
+                    goto EXIT;
+                }
+            }
+            data = window + (checks[k].offset - base);
+            avail = checks[k].offset - base < (off_t)nr ? nr - (checks[k].offset - base) : 0;
+        }
+        if( ! data ){
+            puts("verify: failed to read file");
+            goto EXIT;
+        }
+        if( avail > len ){
+            avail = len;
+        }
+
+        avail = verify_overlay(&checks[k], data, avail, size, writes, ends, nwrites, found, buf);
+        if( avail != len ){
+            printf("verify: expected to read '%zu' bytes at offset '%lld', actually read '%zu'\n",
+                   len, (long long int)checks[k].offset, avail);
+            goto EXIT;
+        }
+
+        if( memcmp(buf, checks[k].i->argument.str, len) ){
+            printf("verify: expected string '%.*s' at offset '%lld', got '%.*s', nothing was written\n",
+                   (int)len, checks[k].i->argument.str, (long long int)checks[k].offset, (int)len, buf);
+            goto EXIT;
+        }
+    }
+
+    ret = 0;
+
+EXIT:
+    free(checks);
+    free(writes);
+    free(ends);
+    free(found);
+    return ret;
+}
+
+
+/***** planner *****/
+
+/* one b, e or w command of a planned stretch of program */
+struct PlanOp {
+    struct Instruction *i;
+    /* cursor when it runs in order */
+    off_t offset;
+    /* length of file when it runs in order, as far as an expect can tell */
+    off_t size;
+};
+
+/* a b command and the e and w commands following it up to the next b */
+struct PlanGroup {
+    /* span of file the group reads or writes */
+    off_t lo;
+    off_t hi;
+    /* group is ops[first, last) */
+    size_t first;
+    size_t last;
+};
+
+int plan_compare_offset(const void *a, const void *b){
+    const struct PlanGroup *x = a;
+    const struct PlanGroup *y = b;
+
+    if( x->lo != y->lo ){
+        return x->lo < y->lo ? -1 : 1;
+    }
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+int plan_compare_order(const void *a, const void *b){
+    const struct PlanGroup *x = a;
+    const struct PlanGroup *y = b;
+
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+/* commands a planned stretch is made of */
+int plan_plannable(enum Command command){
+    return command == BYTE || command == EXPECT || command == WRITE;
+}
+
+/* run the stretch of b, e and w commands starting at the b *cur
+ * in one forward sweep over the file instead of in program order
+ *
+ * groups whose spans overlap form a cluster which keeps program order,
+ * clusters never share a byte so run in order of offset
+ * a first read-only sweep finds the first expect in program order that
+ * would fail, the second sweep then performs only the writes before it,
+ * leaving the file exactly as running in order would have
+ *
+ * *cur is set to the last instruction of the stretch
+ *
+ * returns 0 on success
+ * returns 1 on failure
+ */
+int plan_run(struct Program *p, struct Instruction **cur){
+    struct Instruction *i = 0;
+    struct Instruction *last = 0;
+    struct PlanOp *ops = 0;
+    struct PlanGroup *groups = 0;
+    /* copy of a cluster's span the first sweep runs it against */
+    char *buf = 0;
+    char *grown = 0;
+    size_t buf_len = 0;
+    const char *data = 0;
+    size_t nr = 0;
+    size_t nops = 0;
+    size_t ngroups = 0;
+    /* index of the first failing expect, nops if there is none */
+    size_t failed = 0;
+    size_t len = 0;
+    size_t g = 0;
+    size_t end = 0;
+    size_t k = 0;
+    size_t j = 0;
+    off_t cursor = 0;
+    off_t size = 0;
+    off_t lo = 0;
+    off_t hi = 0;
+    int ret = 1;
+
+    /* the stretch sees the file as edited so far */
+    if( p->pending.len && edit_apply(p) ){
+        puts("plan_run: failed to apply pending edits");
         return 1;
     }
 
-    source = program->source;
+    for( i = *cur; i < p->code + p->code_len && plan_plannable(i->command); ++i ){
+        last = i;
+        ++nops;
+        if( i->command == BYTE ){
+            ++ngroups;
+        }
+    }
 
-    store = &(program->start);
+    ops = malloc(nops * sizeof(*ops));
+    groups = malloc(ngroups * sizeof(*groups));
+    if( ! ops || ! groups ){
+        puts("plan_run: call to malloc failed");
+        goto EXIT;
+    }
 
-    while( source[index] ){
-        switch( source[index] ){
-            case 'p':
-            case 'P':
-                res = parse_print(source, &index);
-                if( ! res ){
-                    puts("parse: failed in call to parse_print");
-                    return 1;
+    size = p->engine->size(p);
+    if( size == -1 ){
+        goto EXIT;
+    }
+
+    /* work out where each command runs as if run in order */
+    cursor = p->offset;
+    g = 0;
+    for( i = *cur, k = 0; k < nops; ++i, ++k ){
+        if( i->command == BYTE ){
+            cursor = i->argument.num;
+            groups[g].lo = cursor;
+            groups[g].hi = cursor;
+            groups[g].first = k;
+            if( g ){
+                groups[g - 1].last = k;
+            }
+            ++g;
+        }
+
+        ops[k].i = i;
+        ops[k].offset = cursor;
+        ops[k].size = size;
+
+        if( i->command == EXPECT || i->command == WRITE ){
+            len = i->argument.num;
+            if( cursor + (off_t)len > groups[g - 1].hi ){
+                groups[g - 1].hi = cursor + len;
+            }
+        }
+
+        if( i->command == WRITE ){
+            cursor += len;
+            if( cursor > size ){
+                size = cursor;
+            }
+        }
+    }
+    groups[g - 1].last = nops;
+
+    qsort(groups, ngroups, sizeof(*groups), plan_compare_offset);
+
+    /* first sweep, read each cluster once and run its commands against
+     * a copy to find the first failing expect
+     */
+    failed = nops;
+    for( g = 0; g < ngroups; g = end ){
+        lo = groups[g].lo;
+        hi = groups[g].hi;
+        for( end = g + 1; end < ngroups && groups[end].lo < hi; ++end ){
+            if( groups[end].hi > hi ){
+                hi = groups[end].hi;
+            }
+        }
+
+        qsort(&(groups[g]), end - g, sizeof(*groups), plan_compare_order);
+
+        /* nothing in this cluster runs before the failure already found */
+        if( failed <= groups[g].first || lo == hi ){
+            continue;
+        }
+
+        if( buf_len < (size_t)(hi - lo) ){
+            grown = realloc(buf, hi - lo);
+            if( ! grown ){
+                puts("plan_run: call to realloc failed");
+                goto EXIT;
+            }
+            buf = grown;
+            buf_len = hi - lo;
+        }
+
+        data = p->engine->view(p, buf, hi - lo, lo, &nr);
+        if( ! data ){
+            puts("plan_run: failed to read file");
+            goto EXIT;
+        }
+        if( data != buf ){
+            memcpy(buf, data, nr);
+        }
+        /* past end of file reads as the hole a write would leave */
+        memset(buf + nr, 0, (hi - lo) - nr);
+
+        for( k = g; k < end; ++k ){
+            for( j = groups[k].first; j < groups[k].last && j < failed; ++j ){
+                len = ops[j].i->argument.num;
+                if( ops[j].i->command == WRITE ){
+                    memcpy(buf + (ops[j].offset - lo), ops[j].i->argument.str, len);
+                } else if(    ops[j].i->command == EXPECT
+                           && (    ops[j].offset + (off_t)len > ops[j].size
+                                || memcmp(buf + (ops[j].offset - lo), ops[j].i->argument.str, len) )
+                ){
+                    failed = j;
+                }
+            }
+        }
+    }
+
+    /* second sweep, perform the writes which run before any failure */
+    for( g = 0; g < ngroups; ++g ){
+        for( k = groups[g].first; k < groups[g].last && k < failed; ++k ){
+            if( ops[k].i->command != WRITE ){
+                continue;
+            }
+            p->offset = ops[k].offset;
+            if( eval_write(p, ops[k].i) ){
+                goto EXIT;
+            }
+        }
+    }
+
+    if( failed < nops ){
+        /* file is now as it was when the expect ran in order,
+         * run it for real to report why it fails
+         */
+        p->offset = ops[failed].offset;
+        eval_expect(p, ops[failed].i);
+        goto EXIT;
+    }
+
+    p->offset = cursor;
+    p->engine->seek(p, p->offset);
+    *cur = last;
+    ret = 0;
+
+EXIT:
+    free(ops);
+    free(groups);
+    free(buf);
+    return ret;
+}
+
+/* commands which can run with edits pending
+ * the rest need pending edits applied first
+ */
+int edit_deferrable(enum Command command){
+    switch( command ){
+        case PRINT:
+        case RAW:
+        case HEXDUMP:
+        case BYTE:
+        case EXPECT:
+        case WRITE:
+        case INSERT:
+        case DELETE:
+        case QUIT:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+/* dispatch each instruction of provided Program in turn
+ * prefetching the bytes of those ahead into ahead, if it is given
+ * return 0 on success
+ * return 1 on failure
+ * return -1 on explicit quit
+ */
+int dispatch_each(struct Program *p, struct Prefetch *ahead){
+    /* cursor into program */
+    struct Instruction *cur = 0;
+    /* return code from individual eval_ calls */
+    int ret = 0;
+
+    /* simple dispatch function */
+    for( cur = p->code; cur < p->code + p->code_len; ++cur ){
+        if( ahead ){
+            prefetch(p, ahead, cur - p->code);
+        }
+
+        if( p->pending.len && ! edit_deferrable(cur->command) && edit_apply(p) ){
+            puts("dispatch: failed to apply pending edits");
+            return 1;
+        }
+
+        if( p->plan && cur->command == BYTE ){
+            ret = plan_run(p, &cur);
+            if( ret ){
+                return ret;
+            }
+            continue;
+        }
+
+        switch( cur->command ){
+            case PRINT:
+                ret = eval_print(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
                 break;
 
-            case 'b':
-            case 'B':
-                res = parse_byte(source, &index);
-                if( ! res ){
-                    puts("parse: failed in call to parse_byte");
-                    return 1;
+            case RAW:
+                ret = eval_raw(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
                 break;
 
-            case 'l':
-            case 'L':
-                res = parse_line(source, &index);
-                if( ! res ){
-                    puts("parse: failed in call to parse_line");
-                    return 1;
+            case HEXDUMP:
+                ret = eval_hexdump(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case LINE:
+                ret = eval_line(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case BYTE:
+                ret = eval_byte(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case SEARCH:
+                ret = eval_search(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case SEARCH_BACK:
+                ret = eval_search_back(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case REGEX:
+                ret = eval_regex(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case EXPECT:
+                ret = eval_expect(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case WRITE:
+                ret = eval_write(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case HASH:
+                ret = eval_hash(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
                 break;
 
-            case 'e':
-            case 'E':
-                res = parse_expect(source, &index);
-                if( ! res ){
-                    puts("parse: failed in call to parse_expect");
-                    return 1;
+            case EXPECT_HASH:
+                ret = eval_expect_hash(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
                 break;
 
-            case 'w':
-            case 'W':
-                res = parse_write(source, &index);
-                if( ! res ){
-                    puts("parse: failed in call to parse_write");
-                    return 1;
+            case WRITE_FILE:
+                ret = eval_write_file(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
                 break;
 
-            case 't':
-            case 'T':
-                res = parse_truncate(source, &index);
-                if( ! res ){
-                    puts("Parse: failed in call to parse_truncate");
-                    return 1;
+            case SUBSTITUTE:
+                ret = eval_substitute(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
                 break;
 
-            case 'q':
-            case 'Q':
-                res = parse_quit(source, &index);
-                if( ! res ){
-                    puts("parse: failed in call to parse_quit");
-                    return 1;
+            case INSERT:
+                ret = eval_insert(p, cur);
+                if( ret ){
+                    return ret;
                 }
-                *store = res;
-                store = &(res->next);
-                goto EXIT;
                 break;
 
-            case '#':
-                if( parse_comment(source, &index) ){
-                    puts("parse: parsing comment failed");
-                    return 1;
+            case DELETE:
+                ret = eval_delete(p, cur);
+                if( ret ){
+                    return ret;
                 }
                 break;
 
-            /* skip over whitespace
-             * whitespace is insignificant EXCEPT for \n denoting end of comment
-             */
-            case ' ':
-            case '\t':
-            case '\n':
-                /* actually skip over whitespace */
-                ++index;
+            case TRUNCATE:
+                ret = eval_truncate(p, cur);
+                if( ret ){
+                    return ret;
+                }
+                break;
+
+            case QUIT:
+                /* explicit quit, return -1 */
+                return -1;
                 break;
 
             default:
-                printf("parse: Invalid character encountered '%c'\n", source[index]);
+                puts("execute: invalid command type encountered in execute");
                 return 1;
                 break;
         }
     }
 
-EXIT:
-
-    /* null terminator for program */
-    *store = 0;
-
+    /* implicit (EOF) quit => exit quietly */
     return 0;
 }
 
+/* dispatch provided Program, with prefetching unless it is turned off
+ * return 0 on success
+ * return 1 on failure
+ * return -1 on explicit quit
+ */
+int dispatch(struct Program *p){
+    struct Prefetch ahead;
+    int ret = 0;
+
+    if( !p ){
+        puts("dispatch: called with null program");
+        return 1;
+    }
 
+    if( ! p->prefetch ){
+        return dispatch_each(p, 0);
+    }
 
+    prefetch_init(&ahead, p);
+    ret = dispatch_each(p, &ahead);
+    prefetch_finish(p, &ahead);
 
-/***** evaluation functions *****/
+    return ret;
+}
 
-/* eval PRINT command
- * print specified number of bytes
- * defaults to 100 bytes if number isn't specified
- *
- *  p
- *  p127
- *
- * uses cur->argument.num
+/* execute provided Program
+ * inserts and deletes still pending when it stops are applied,
+ * whether or not it succeeded, as they would have been had they run at once
  *
- * returns 0 on success
- * returns 1 on failure
- * failure will cause program to halt
+ * return 0 on success
+ * return 1 on failure
+ * return -1 on explicit quit
  */
-int eval_print(struct Program *p, struct Instruction *cur){
-    /* number of bytes to read */
-    long int num = cur->argument.num;
-    char *buf = 0;
-    /* number of bytes read */
-    size_t nr = 0;
+int execute(struct Program *p){
+    int ret = 0;
 
-    /* default to 100 bytes */
-    if( ! num ){
-        num = 100;
+    if( !p ){
+        puts("execute: called with null program");
+        return 1;
     }
 
-    /* 1 + num to fit num bytes and null */
-    buf = get_buffer(p, 1+num);
-    if( ! buf ){
-        puts("eval_print: call to get_buffer failed");
+    if( p->verify && verify(p) ){
         return 1;
     }
 
-    /* read into buffer */
-    nr = fread(buf, 1, num, p->file);
-    /* make sure buffer is really a string */
-    buf[nr] = '\0';
+    ret = dispatch(p);
 
-    /* seek back to previous position */
-    if( fseek(p->file, p->offset, SEEK_SET) ){
-        puts("eval_print: fseek failed");
+    if( edit_apply(p) ){
+        puts("execute: failed to apply pending edits");
         return 1;
     }
 
-    /* print buffer, as instructed */
-    printf("'%s'\n", buf);
+    if( p->engine->flush(p) ){
+        puts("execute: failed to finish writes");
+        return 1;
+    }
 
-    return 0;
+    return ret;
 }
 
-/* eval BYTE command
- * move spcified number of bytes 'forward' through text
- *
- *  b427
- *
- * uses cur->argument.num
- *
- * returns 0 on success
- * returns 1 on failure
- * failure will cause program to halt
- */
-int eval_byte(struct Program *p, struct Instruction *cur){
-    /* byte number argument to seek to */
-    long int byte = 0;
 
-    byte = cur->argument.num;
+/* empties the program of instructions allocated while parsing
+ * keeping the array itself for the next parse
+ */
+void scrub(struct Program *p)
+{
+    size_t k = 0;
 
-    if( fseek(p->file, byte, SEEK_SET) ){
-        puts("eval_byte: fseek failed");
-        return 1;
+    for( k = 0; k < p->code_len; ++k ){
+        if( p->code[k].command == REGEX ){
+            dfa_free(p->code[k].argument.dfa);
+        }
     }
+    p->code_len = 0;
+}
 
-    /* update file offset */
-    p->offset = byte;
+int repl(struct Program *p){
+    int exit_code = EXIT_FAILURE;
+    char line[4096]; /* FIXME: Perhaps use slurp-like behaviour instead */
 
-    return 0;
-}
+    while( 1 ){
+        printf("dodo [%lld]: ", (long long int)p->offset);
+        p->source = fgets(line, sizeof(line), stdin);
 
-int eval_line(struct Program *p, struct Instruction *cur){
-    char buffer[1024];
-    int observed = 0;
-    int i = 0;
-    size_t nread = 0;
+        if( ! p->source ){
+            if( feof(stdin) ){
+                exit_code = EXIT_SUCCESS;
+            } else {
+                printf("fgets failed in repl\n");
+                exit_code = EXIT_FAILURE;
+            }
+            goto EXIT;
+        }
 
-    /* first things first; seek to start of file */
-    if( fseek(p->file, 0, SEEK_SET) ){
-        puts("eval_line: fseek failed");
-        return 1;
+        /* note we don't error-out on parse or execute,
+         * keep the repl rolling */
+        if( parse(p) ){
+            printf("Parsing program failed in repl\n");
+        } else {
+            if( execute(p) == -1 ){
+                goto EXIT;
+            }
+        }
+
+        scrub(p);
     }
-    p->offset = 0;
 
-    /* nothing more to be done if line 1 was requested */
-    if( cur->argument.num == 1 ){
+EXIT:
+    /* force null to stop free() */
+    p->source = NULL;
+    return exit_code;
+}
+
+
+/* size of reads of a streamed program
+ * the buffer doubles whenever one instruction does not fit
+ */
+#define STREAM_SIZE (1 << 18)
+
+/* index just past the delimited string opening at source[at]
+ * returns 0 if source ends first
+ */
+size_t stream_delimited(const char *source, size_t at, char delim){
+    if( source[at] == '\0' ){
         return 0;
     }
 
-    while( (nread = fread(buffer, 1, sizeof(buffer), p->file)) ){
-        for( i = 0; i < nread; i++ ){
-            if( buffer[i] == '\n' && ++observed >= cur->argument.num - 1 ){
-                /* +1 to skip over \n */
-                p->offset += i + 1;
-                if( fseek(p->file, p->offset, SEEK_SET) ){
-                    puts("eval_line: fseek failed");
-                    return 1;
-                }
-                return 0;
-            }
+    if( source[at] != delim ){
+        /* not a string, leave parse to report it */
+        return at;
+    }
+
+    for( ++at; source[at] != delim; ++at ){
+        if( source[at] == '\0' ){
+            return 0;
+        }
+        if( source[at] == '\\' && source[++at] == '\0' ){
+            return 0;
         }
-        p->offset += nread;
     }
 
-    printf("eval_line: read error before reaching line %ld\n", cur->argument.num);
-    return 1;
+    return at + 1;
 }
 
-/* eval EXPECT command
- * check current location matches specified string
- * throws error if string does not match
- *
- *  e/hello/
+/* index just past the instruction, comment or whitespace at source[at]
+ * this only needs to find where it ends, parse checks what it says
  *
- * uses cur->argument.str
- *
- * returns 0 on success
- * returns 1 on failure
- * failure will cause program to halt
+ * returns 0 if it reaches the end of source and so may run on past it
  */
-int eval_expect(struct Program *p, struct Instruction *cur){
-    /* string to compare to */
-    char *str = 0;
-    /* length of string */
-    size_t len = 0;
-    /* buffer read into */
-    char *buf = 0;
-    /* num bytes read */
-    size_t nr = 0;
+size_t stream_extent(const char *source, size_t at){
+    size_t end = 0;
 
-    str = cur->argument.str;
-    if( ! str ){
-        puts("eval_expect: no string argument found");
-        return 1;
-    }
+    switch( source[at] ){
+        case 'p':
+        case 'P':
+        case 'c':
+        case 'C':
+        case 'x':
+        case 'X':
+        case 'b':
+        case 'B':
+        case 'd':
+        case 'D':
+            end = at + 1 + strspn(source + at + 1, "0123456789x");
+            break;
 
-    len = cur->argument.num;
+        case 'l':
+        case 'L':
+            end = at + 1 + strspn(source + at + 1, "+-$0123456789x");
+            break;
 
-    /*1 + len to fit len bytes + null terminator */
-    buf = get_buffer(p, 1+len);
-    if( ! buf ){
-        puts("eval_expect: call to get_buffer failed");
-        return 1;
-    }
+        case 'e':
+        case 'E':
+            if( source[at + 1] == '#' ){
+                /* checksum, then any count */
+                end = stream_delimited(source, at + 1, '#');
+                if( end ){
+                    end += strspn(source + end, "0123456789x");
+                }
+                break;
+            }
+            end = stream_delimited(source, at + 1, '/');
+            break;
 
-    /* perform read */
-    nr = fread(buf, 1, len, p->file);
-    /* make sure buffer is really a string */
-    buf[nr] = '\0';
+        case 'h':
+        case 'H':
+            end = at + 1 + strspn(source + at + 1, "0123456789x");
+            break;
 
-    /* seek back to previous position */
-    if( fseek(p->file, p->offset, SEEK_SET) ){
-        puts("eval_expect: fseek failed");
-        return 1;
-    }
+        case 'w':
+        case 'W':
+        case 'i':
+        case 'I':
+        case 'r':
+        case 'R':
+            end = stream_delimited(source, at + 1, '/');
+            break;
 
-    /* compare number read to expected len */
-    if( nr != len ){
-        /* FIXME consider output when expect fails */
-        printf("eval_expect: expected to read '%zu' bytes, actually read '%zu'\n", len, nr);
-        return 1;
+        case 's':
+        case 'S':
+            /* middle delimiter closes old and opens new, then the g */
+            end = stream_delimited(source, at + 1, '/');
+            if( end > at + 1 ){
+                end = stream_delimited(source, end - 1, '/');
+            }
+            if( end && source[end] == 'g' ){
+                ++end;
+            }
+            break;
+
+        case 'f':
+        case 'F':
+            /* path, then any byte range */
+            end = stream_delimited(source, at + 1, '/');
+            if( end ){
+                end += strspn(source + end, "0123456789x,");
+            }
+            break;
+
+        case '/':
+            end = stream_delimited(source, at, '/');
+            break;
+
+        case '?':
+            end = stream_delimited(source, at, '?');
+            break;
+
+        case '#':
+            end = at + strcspn(source + at, "\n");
+            break;
+
+        default:
+            end = at + 1;
+            break;
     }
 
-    /* compare read string to expected str */
-    if( strncmp(str, buf, len) ){
-        /* add terminating \0 to allow printf-ing */
-        str[len] = '\0';
-        /* FIXME consider output when expect fails */
-        printf("eval_expect: expected string '%s', got '%s'\n", str, buf);
-        return 1;
+    if( ! end || source[end] == '\0' ){
+        return 0;
     }
 
-    return 0;
+    return end;
 }
 
-/* eval WRITE command
- * write specified string
- * will overwrite existing text in place
- *
- *  w/world/
- *
- * uses cur->argument.str
+/* read, parse and execute the program from stdin a buffer at a time
+ * so it never has to be held whole, the instructions parsed from each
+ * buffer are executed and freed before the next is read
  *
- * returns 0 on success
- * returns 1 on failure
- * failure will cause program to halt
+ * only complete instructions are parsed, the rest of a buffer is kept
+ * to be parsed along with the next read
+ * a parse error stops the program there, after what came before it has run
+ *
+ * return 0 on success
+ * return 1 on failure
+ * return -1 on explicit quit
  */
-int eval_write(struct Program *p, struct Instruction *cur){
-    /* string to write */
-    char *str = 0;
-    /* len of str */
+int stream(struct Program *p){
+    /* bytes allocated to p->source, including terminator */
+    size_t cap = STREAM_SIZE;
+    /* bytes of p->source read and not yet parsed */
+    size_t fill = 0;
+    /* end of complete instructions in p->source */
+    size_t cut = 0;
+    size_t end = 0;
     size_t len = 0;
-    /* number of bytes written */
-    size_t nw = 0;
+    size_t want = 0;
+    char *grown = 0;
+    char saved = 0;
+    int eof = 0;
+    int failed = 0;
+    int ret = 0;
 
-    str = cur->argument.str;
-    if( ! str ){
-        puts("eval_write: no argument string found");
+    p->source = malloc(cap);
+    if( ! p->source ){
+        puts("stream: call to malloc failed");
         return 1;
     }
 
-    len = cur->argument.num;
+    while( ! eof ){
+        /* a single instruction fills the whole buffer */
+        if( fill == cap - 1 ){
+            grown = realloc(p->source, 2 * cap);
+            if( ! grown ){
+                puts("stream: call to realloc failed");
+                ret = 1;
+                break;
+            }
+            p->source = grown;
+            cap *= 2;
+        }
 
-    /* perform write */
-    nw = fwrite(str, 1, len, p->file);
+        want = cap - 1 - fill;
+        len = fread(p->source + fill, 1, want, stdin);
+        fill += len;
+        p->source[fill] = '\0';
+        if( len < want ){
+            if( ferror(stdin) ){
+                puts("stream: reading program failed");
+                ret = 1;
+                break;
+            }
+            eof = 1;
+        }
 
-    /* check length */
-    if( nw != len ){
-        printf("eval_write: expected to write '%zu' bytes, actually wrote '%zu'\n", len, nw);
-        return 1;
-    }
+        for( cut = 0; cut < fill && (end = stream_extent(p->source, cut)); cut = end ){
+        }
+        if( eof ){
+            cut = fill;
+        }
 
-    /* update file offset to be at end of write */
-    p->offset += nw;
+        saved = p->source[cut];
+        p->source[cut] = '\0';
+        failed = parse(p);
+        p->source[cut] = saved;
 
-    /* seek to end of write */
-    if( fseek(p->file, p->offset, SEEK_SET) ){
-        puts("eval_write: fseek failed");
-        return 1;
+        /* instructions parsed before any error still run */
+        ret = dispatch(p);
+        scrub(p);
+        if( ret ){
+            break;
+        }
+
+        if( failed ){
+            puts("stream: parsing program failed");
+            ret = 1;
+            break;
+        }
+
+        memmove(p->source, p->source + cut, fill - cut);
+        fill -= cut;
     }
 
-    /* flush file */
-    if( fflush(p->file) ){
-        puts("eval_write: error flushing file");
+    /* as execute does, edits made before stopping are applied */
+    if( edit_apply(p) ){
+        puts("stream: failed to apply pending edits");
         return 1;
     }
 
-    return 0;
+    return ret;
 }
 
-/* eval TRUNCATE command
- * truncate file at cursor position
+
+
+/***** batch *****/
+/* file of a batch run, and how running the program against it went */
+struct BatchFile {
+    char *path;
+    /* set if the file could not be opened or the program failed against it */
+    int failed;
+};
+
+/* shared between batch workers
+ * each worker claims the next file to run under lock until none are left
+ */
+struct Batch {
+    /* program parsed once by main, workers run copies of it */
+    const struct Program *program;
+    struct BatchFile *files;
+    size_t len;
+    /* index of next unclaimed file */
+    size_t next;
+    pthread_mutex_t lock;
+    int use_index;
+};
+
+/* copy instructions of program into p
+ * strings are shared, but dfas cache states as they run
+ * so every copy compiles its own
+ *
  * returns 0 on success
  * returns 1 on failure
- * failure will cause program to halt
  */
-int eval_truncate(struct Program *p, struct Instruction *cur){
-    if( truncate(p->path, p->offset) == -1 ){
-        perror("eval_truncate: error in call to truncate");
-        return 1;
+int batch_copy(struct Program *p, const struct Program *program){
+    struct Instruction *i = 0;
+    size_t k = 0;
+
+    for( k = 0; k < program->code_len; ++k ){
+        i = new_instruction(p, program->code[k].command);
+        if( ! i ){
+            puts("batch_copy: call to new_instruction failed");
+            return 1;
+        }
+        i->argument = program->code[k].argument;
+
+        if( i->command == REGEX ){
+            i->argument.dfa = dfa_compile(i->argument.str, i->argument.num);
+            if( ! i->argument.dfa ){
+                puts("batch_copy: call to dfa_compile failed");
+                return 1;
+            }
+        }
+
+        ++(p->code_len);
     }
+
     return 0;
 }
 
-/* execute provided Program
- * return 0 on success
- * return 1 on failure
+/* run program in p against file at path, leaving p ready for the next file
+ * buffers are kept from file to file
+ *
+ * returns 0 on success
+ * returns 1 on failure
  */
-int execute(struct Program *p){
-    /* cursor into program */
-    struct Instruction *cur = 0;
-    /* return code from individual eval_ calls */
+int batch_file(struct Program *p, int use_index, char *path){
     int ret = 0;
 
-    if( !p ){
-        puts("execute: called with null program");
+    p->path = path;
+    p->offset = 0;
+
+    if( p->engine->open(p) ){
+        printf("batch_file: failed to open '%s'\n", path);
         return 1;
     }
 
-    /* simple dispatch function */
-    for( cur = p->start; cur; cur = cur->next ){
-        switch( cur->command ){
-            case PRINT:
-                ret = eval_print(p, cur);
-                if( ret ){
-                    return ret;
-                }
-                break;
+    if( use_index ){
+        p->index = index_open(p);
+        if( ! p->index ){
+            printf("batch_file: opening line index of '%s' failed\n", path);
+            ret = 1;
+            goto EXIT;
+        }
+    }
 
-            case LINE:
-                ret = eval_line(p, cur);
-                if( ret ){
-                    return ret;
-                }
-                break;
+    if( execute(p) > 0 ){
+        printf("batch_file: program execution failed on '%s'\n", path);
+        ret = 1;
+    }
 
-            case BYTE:
-                ret = eval_byte(p, cur);
-                if( ret ){
-                    return ret;
-                }
-                break;
+EXIT:
+    if( p->index ){
+        /* index still describes the file even if execution failed */
+        if( index_save(p) ){
+            printf("batch_file: saving line index of '%s' failed\n", path);
+        }
+        index_free(p->index);
+        p->index = 0;
+    }
 
-            case EXPECT:
-                ret = eval_expect(p, cur);
-                if( ret ){
-                    return ret;
-                }
-                break;
+    /* only left over if applying them failed */
+    edit_free(p);
+    p->engine->close(p);
 
-            case WRITE:
-                ret = eval_write(p, cur);
-                if( ret ){
-                    return ret;
-                }
-                break;
+    return ret;
+}
 
-            case TRUNCATE:
-                ret = eval_truncate(p, cur);
-                if( ret ){
-                    return ret;
-                }
-                break;
+/* pthread start routine, runs the program against files until none are left */
+void * batch_worker(void *arg){
+    struct Batch *batch = arg;
+    struct Program p = {0};
+    size_t k = 0;
+    int failed = 0;
 
-            case QUIT:
-                /* explicit quit, return -1 */
-                return -1;
-                break;
+    p.fd = -1;
+    p.engine = batch->program->engine;
+    p.plan = batch->program->plan;
+    p.prefetch = batch->program->prefetch;
+    p.verify = batch->program->verify;
+    /* files are already run in parallel, seek lines sequentially */
+    p.jobs = 1;
 
-            default:
-                puts("execute: invalid command type encountered in execute");
-                return 1;
-                break;
+    failed = batch_copy(&p, batch->program);
+
+    while( 1 ){
+        pthread_mutex_lock(&batch->lock);
+        k = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        if( k >= batch->len ){
+            break;
         }
+
+        /* a worker unable to copy the program still fails its share of files */
+        batch->files[k].failed = failed || batch_file(&p, batch->use_index, batch->files[k].path);
     }
 
-    /* implicit (EOF) quit => exit quietly */
+    scrub(&p);
+    free(p.code);
+    free(p.buf);
+    free(p.block);
+    free(p.pending.edits);
+    free(p.pending.buf);
+
     return 0;
 }
 
-
-/* frees the elements of the linked list of instructions
- * allocated while parsing
+/* run program against each of paths[0, len) on a pool of jobs workers
+ * then print how each file went
+ *
+ * returns 0 if program succeeded against every file
+ * returns 1 on failure
  */
-void scrub(struct Program *p)
-{
-    struct Instruction *now = 0;
-    struct Instruction *next = 0;
-    if( p->start ){
-        now = p->start;
-        do {
-            next = now->next;
-            free(now);
-            now = next;
-        } while( next );
+int batch(const struct Program *program, int use_index, int jobs, char **paths, size_t len){
+    struct Batch batch;
+    pthread_t threads[MAX_JOBS];
+    size_t failures = 0;
+    size_t k = 0;
+    int err = 0;
+    int j = 0;
+
+    batch.program = program;
+    batch.use_index = use_index;
+    batch.len = len;
+    batch.next = 0;
+
+    batch.files = calloc(len, sizeof(*(batch.files)));
+    if( ! batch.files ){
+        puts("batch: call to calloc failed");
+        return 1;
+    }
+    for( k = 0; k < len; ++k ){
+        batch.files[k].path = paths[k];
     }
-    p->start = NULL;
-}
 
-int repl(struct Program *p){
-    int exit_code = EXIT_FAILURE;
-    char line[4096]; /* FIXME: Perhaps use slurp-like behaviour instead */
+    err = pthread_mutex_init(&batch.lock, 0);
+    if( err ){
+        printf("batch: pthread_mutex_init failed: %s\n", strerror(err));
+        free(batch.files);
+        return 1;
+    }
 
-    while( 1 ){
-        printf("dodo [%ld]: ", p->offset);
-        p->source = fgets(line, sizeof(line), stdin);
+    if( jobs < 1 ){
+        jobs = 1;
+    }
+    if( (size_t)jobs > len ){
+        jobs = len;
+    }
 
-        if( ! p->source ){
-            if( feof(stdin) ){
-                exit_code = EXIT_SUCCESS;
-            } else {
-                printf("fgets failed in repl\n");
-                exit_code = EXIT_FAILURE;
-            }
-            goto EXIT;
-        }
+    /* settle on scan and hash kernels before workers race to */
+    scan_kernel();
+    hash_kernel();
 
-        /* note we don't error-out on parse or execute,
-         * keep the repl rolling */
-        if( parse(p) ){
-            printf("Parsing program failed in repl\n");
-        } else {
-            if( execute(p) == -1 ){
-                goto EXIT;
-            }
+    for( j = 0; j < jobs; ++j ){
+        err = pthread_create(&threads[j], 0, batch_worker, &batch);
+        if( err ){
+            printf("batch: pthread_create failed: %s\n", strerror(err));
+            /* workers already started take on the remaining files */
+            break;
         }
+    }
 
-        scrub(p);
+    if( ! j ){
+        /* not a single worker, run the files here instead */
+        batch_worker(&batch);
     }
 
-EXIT:
-    /* force null to stop free() */
-    p->source = NULL;
-    return exit_code;
+    while( j-- ){
+        pthread_join(threads[j], 0);
+    }
+
+    pthread_mutex_destroy(&batch.lock);
+
+    for( k = 0; k < len; ++k ){
+        printf("%s %s\n", batch.files[k].failed ? "FAILED" : "ok", batch.files[k].path);
+        failures += batch.files[k].failed;
+    }
+    printf("%zu of %zu files failed\n", failures, len);
+
+    free(batch.files);
+
+    return failures ? 1 : 0;
 }
 
 
@@ -1102,7 +7206,7 @@ void usage(void){
          "and will read commands from stdin\n"
          "\n"
          "example:\n"
-         "  dodo [-i|--interactive] <filename> <<EOF\n"
+         "  dodo [-i|--interactive] [-x|--index] [-j|--jobs n] [-s|--stream] [-P|--plan] [-V|--verify-first] [-m|--mmap|--pread|--stdio|--uring|--direct] <filename> <<EOF\n"
          "  b6        # goto byte 6\n"
          "  e/world/  # check for string 'world'\n"
          "  w/hello/  # write string 'hello'\n"
@@ -1112,21 +7216,71 @@ void usage(void){
          "supported commands:\n"
          "  bn        # goto byte <n> of file\n"
          "  ln        # goto line <n> of file\n"
+         "  l+n, l-n  # goto <n> lines after or before line holding cursor\n"
+         "  l$, l$-n  # goto last line of file, or <n> lines before it\n"
          "  p         # print 100 bytes\n"
          "  pn        # print n bytes\n"
+         "  c, cn     # copy 100 or n bytes to stdout as they are\n"
+         "  x, xn     # print 100 or n bytes in hex\n"
+         "  /str/     # goto next occurrence of <str> at or after current position\n"
+         "  ?str?     # goto last occurrence of <str> starting before current position\n"
+         "  r/re/     # goto next match of regular expression <re> at or after current position\n"
          "  e/str/    # compare <str> to current position, exit if not equal\n"
+         "  h, hn     # print crc32c of rest of file or <n> bytes, as e#c#n\n"
+         "  e#c#n     # compare crc32c <c> to <n> bytes at current position, exit if not equal\n"
          "  w/str/    # write <str> to current position\n"
+         "  f/path/   # write contents of file at <path> to current position\n"
+         "  f/p/n,c   # write <c> bytes of file at <p> from byte <n>\n"
+         "  s/a/b/g   # replace every <a> in file with <b> of the same length\n"
+         "  i/str/    # insert <str> at current position\n"
+         "  d, dn     # delete 1 or <n> bytes at current position\n"
          "  q         # quit editing\n"
          "  # used for commenting out rest of line\n"
+         "\n"
+         "options:\n"
+         "  -i, --interactive  # read and execute commands a line at a time\n"
+         "  -x, --index        # keep a line index in <filename>.dodoidx to speed up ln\n"
+         "  -j, --jobs n       # use n threads when scanning for lines,\n"
+         "                     # or to run n files at a time given several\n"
+         "  -s, --stream       # parse and execute the program as it is read, not all at once\n"
+         "  -P, --plan         # run stretches of b, e and w commands in one sweep by offset\n"
+         "  -V, --verify-first # check expects at known offsets in one sweep before writing anything\n"
+         "  --no-prefetch      # do not ask the kernel to read ahead for the commands to come\n"
+         "  -m, --mmap         # access <filename> through a shared memory mapping\n"
+         "  --pread            # access <filename> through pread and pwrite (default)\n"
+         "  --stdio            # access <filename> through stdio\n"
+         "  --uring            # access <filename> through io_uring, many reads and writes at once\n"
+         "  --direct           # access <filename> with O_DIRECT, keeping it out of the page cache\n"
+         "  --load compiled    # run program saved by --compile rather than reading stdin\n"
+         "\n"
+         "batch:\n"
+         "  dodo [-j n] <filename> <filename>...  # run the program against each file, n at a time\n"
+         "\n"
+         "compiling:\n"
+         "  dodo --compile <program> -o <compiled>  # parse <program>, or stdin if '-', and save it\n"
     );
 }
 
 int main(int argc, char **argv){
     int exit_code = EXIT_SUCCESS;
     struct Program p = {0};
+    /* index into argv */
+    int arg = 0;
+    /* options */
+    int interactive = 0;
+    int use_index = 0;
+    int streaming = 0;
+    /* compiled program to run */
+    char *load = 0;
+    FILE *file = 0;
+    char *endptr = 0;
+
+    /* nothing open yet */
+    p.fd = -1;
+    p.engine = &pread_engine;
+    p.prefetch = 1;
 
     if(    argc < 2
-        || argc > 3
         || !strcmp("--help", argv[1])
         || !strcmp("-h", argv[1])
     ){
@@ -1134,18 +7288,124 @@ int main(int argc, char **argv){
         exit(EXIT_FAILURE);
     }
 
-    /* catch 'interactive' command line argument */
-    if(    argc == 3
-        && strcmp("--interactive", argv[1])
-        && strcmp("-i", argv[1])
-    ){
-        usage();
+    /* dodo --compile program -o compiled
+     * parses program, or stdin if it is '-', and saves it compiled
+     */
+    if( ! strcmp("--compile", argv[1]) ){
+        if( argc != 5 || strcmp("-o", argv[3]) ){
+            usage();
+            exit(EXIT_FAILURE);
+        }
+
+        file = strcmp("-", argv[2]) ? fopen(argv[2], "rb") : stdin;
+        if( ! file ){
+            printf("Failed to open program '%s'\n", argv[2]);
+            exit(EXIT_FAILURE);
+        }
+        p.source = slurp(file);
+        if( file != stdin ){
+            fclose(file);
+        }
+        if( ! p.source ){
+            puts("Reading program failed");
+            exit_code = EXIT_FAILURE;
+            goto EXIT;
+        }
+
+        if( parse(&p) ){
+            puts("Parsing program failed");
+            exit_code = EXIT_FAILURE;
+            goto EXIT;
+        }
+
+        if( compiled_save(&p, argv[4]) ){
+            puts("Saving compiled program failed");
+            exit_code = EXIT_FAILURE;
+        }
+        goto EXIT;
+    }
+
+    /* options come first, all arguments from the first that is not one
+     * are files, the last argument always is
+     */
+    for( arg = 1; arg < argc - 1 && argv[arg][0] == '-'; ++arg ){
+        if(    ! strcmp("--interactive", argv[arg])
+            || ! strcmp("-i", argv[arg])
+        ){
+            interactive = 1;
+        } else if(    ! strcmp("--index", argv[arg])
+                   || ! strcmp("-x", argv[arg])
+        ){
+            use_index = 1;
+        } else if(    ! strcmp("--stream", argv[arg])
+                   || ! strcmp("-s", argv[arg])
+        ){
+            streaming = 1;
+        } else if(    ! strcmp("--plan", argv[arg])
+                   || ! strcmp("-P", argv[arg])
+        ){
+            p.plan = 1;
+        } else if(    ! strcmp("--verify-first", argv[arg])
+                   || ! strcmp("-V", argv[arg])
+        ){
+            p.verify = 1;
+        } else if( ! strcmp("--no-prefetch", argv[arg]) ){
+            p.prefetch = 0;
+        } else if(    ! strcmp("--mmap", argv[arg])
+                   || ! strcmp("-m", argv[arg])
+        ){
+            p.engine = &map_engine;
+        } else if( ! strcmp("--pread", argv[arg]) ){
+            p.engine = &pread_engine;
+        } else if( ! strcmp("--stdio", argv[arg]) ){
+            p.engine = &stdio_engine;
+        } else if( ! strcmp("--uring", argv[arg]) ){
+            p.engine = &uring_engine;
+        } else if( ! strcmp("--direct", argv[arg]) ){
+            p.engine = &direct_engine;
+        } else if( ! strcmp("--load", argv[arg]) && arg + 1 < argc - 1 ){
+            load = argv[++arg];
+        } else if(    (    ! strcmp("--jobs", argv[arg])
+                        || ! strcmp("-j", argv[arg]) )
+                   && arg + 1 < argc - 1
+        ){
+            p.jobs = strtol(argv[++arg], &endptr, 10);
+            if( *endptr || p.jobs < 1 || p.jobs > MAX_JOBS ){
+                printf("Number of jobs must be between 1 and %d\n", MAX_JOBS);
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if( load && (interactive || streaming) ){
+        puts("--load cannot be combined with --interactive or --stream");
+        exit(EXIT_FAILURE);
+    }
+
+    if( p.verify && (interactive || streaming) ){
+        puts("--verify-first needs the whole program, it cannot be combined with --interactive or --stream");
+        exit(EXIT_FAILURE);
+    }
+
+    if( arg < argc - 1 && (interactive || streaming) ){
+        puts("--interactive and --stream take a single file");
         exit(EXIT_FAILURE);
     }
 
-    /* one-shot read and execute if we're not heading into the repl */
-    if( argc == 2 )
-    {
+    if( load ){
+        /* compiled program needs no parsing */
+        if( compiled_load(&p, load) ){
+            puts("Loading compiled program failed");
+            exit_code = EXIT_FAILURE;
+            goto EXIT;
+        }
+    } else if( ! interactive && ! streaming ){
+        /* one-shot read and execute if we're not heading into the repl
+         * or streaming the program through
+         */
         /* read program into source */
         p.source = slurp(stdin);
         if( ! p.source ){
@@ -1162,18 +7422,41 @@ int main(int argc, char **argv){
         }
     }
 
+    if( arg < argc - 1 ){
+        /* program was parsed once, now run it against every file */
+        if( batch(&p, use_index, p.jobs, argv + arg, argc - arg) ){
+            exit_code = EXIT_FAILURE;
+        }
+        goto EXIT;
+    }
+
     /* open file */
     p.path = argv[argc - 1];
-    p.file = fopen(p.path, "r+b");
-    if( ! p.file ){
+    if( p.engine->open(&p) ){
         printf("Failed to open specified file '%s'\n", argv[argc - 1]);
         exit_code = EXIT_FAILURE;
         goto EXIT;
     }
 
-    if( argc == 3 ) {
+    if( use_index ){
+        p.index = index_open(&p);
+        if( ! p.index ){
+            puts("Opening line index failed");
+            exit_code = EXIT_FAILURE;
+            goto EXIT;
+        }
+    }
+
+    if( interactive ) {
         /* execute the repl */
         repl(&p);
+    } else if( streaming ) {
+        /* read, parse and execute program a buffer at a time */
+        if( stream(&p) > 0 ){
+            puts("Program execution failed");
+            exit_code = EXIT_FAILURE;
+            goto EXIT;
+        }
     } else {
         /* execute program */
         if( execute(&p) > 0 ){
@@ -1186,19 +7469,41 @@ int main(int argc, char **argv){
 EXIT:
 
     scrub(&p);
+    free(p.code);
+
+    if( p.image ){
+        munmap(p.image, p.image_len);
+    }
+
+    if( p.index ){
+        /* index still describes the file even if execution failed */
+        if( index_save(&p) ){
+            puts("Saving line index failed");
+        }
+        index_free(p.index);
+    }
 
     if( p.buf ){
         free(p.buf);
     }
 
-    if( p.file ){
-        fclose(p.file);
+    if( p.block ){
+        free(p.block);
+    }
+
+    if( p.chunks ){
+        free(p.chunks);
     }
 
+    edit_free(&p);
+    free(p.pending.edits);
+    free(p.pending.buf);
+
+    p.engine->close(&p);
+
     if( p.source ){
         free(p.source);
     }
 
     exit(exit_code);
 }
-
@@ -0,0 +1,191 @@
+#include <string.h> /* memcpy */
+
+#include "hash.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HASH_X86 1
+#include <immintrin.h>
+#endif
+
+/* reflected castagnoli polynomial */
+#define HASH_POLY 0x82f63b78u
+
+typedef unsigned int (*crc_fn)(unsigned int crc, const unsigned char *buf, size_t len);
+
+/* table[k][b] is crc of byte b followed by k zero bytes */
+static unsigned int table[8][256];
+
+static void hash_tables(void){
+    unsigned int crc = 0;
+    int b = 0;
+    int k = 0;
+
+    for( b = 0; b < 256; ++b ){
+        crc = b;
+        for( k = 0; k < 8; ++k ){
+            crc = crc & 1 ? (crc >> 1) ^ HASH_POLY : crc >> 1;
+        }
+        table[0][b] = crc;
+    }
+
+    for( b = 0; b < 256; ++b ){
+        for( k = 1; k < 8; ++k ){
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+        }
+    }
+}
+
+/* slicing by 8, folding 8 bytes into the crc with 8 lookups */
+static unsigned int hash_scalar(unsigned int crc, const unsigned char *buf, size_t len){
+    unsigned int lo = 0;
+    unsigned int hi = 0;
+
+    while( len >= 8 ){
+        lo = crc ^ ((unsigned int)buf[0] | (unsigned int)buf[1] << 8 | (unsigned int)buf[2] << 16 | (unsigned int)buf[3] << 24);
+        hi = (unsigned int)buf[4] | (unsigned int)buf[5] << 8 | (unsigned int)buf[6] << 16 | (unsigned int)buf[7] << 24;
+        crc =   table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff]
+              ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24]
+              ^ table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff]
+              ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+        buf += 8;
+        len -= 8;
+    }
+
+    while( len-- ){
+        crc = (crc >> 8) ^ table[0][(crc ^ *buf++) & 0xff];
+    }
+
+    return crc;
+}
+
+#ifdef HASH_X86
+
+__attribute__((target("sse4.2")))
+static unsigned int hash_sse42(unsigned int crc, const unsigned char *buf, size_t len){
+    unsigned long long int c = crc;
+    unsigned long long int word = 0;
+    unsigned int word32 = 0;
+
+    while( len >= 8 ){
+        /* x86 is little endian, as the crc32 instruction expects */
+        memcpy(&word, buf, 8);
+        c = _mm_crc32_u64(c, word);
+        buf += 8;
+        len -= 8;
+    }
+
+    if( len >= 4 ){
+        memcpy(&word32, buf, 4);
+        c = _mm_crc32_u32((unsigned int)c, word32);
+        buf += 4;
+        len -= 4;
+    }
+
+    while( len-- ){
+        c = _mm_crc32_u8((unsigned int)c, *buf++);
+    }
+
+    return (unsigned int)c;
+}
+
+#endif /* HASH_X86 */
+
+static crc_fn kernel = 0;
+static const char *kernel_name = 0;
+
+const char * hash_kernel(void){
+    if( kernel ){
+        return kernel_name;
+    }
+
+#ifdef HASH_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("sse4.2") ){
+        kernel_name = "sse4.2";
+        kernel = hash_sse42;
+        return kernel_name;
+    }
+#endif
+
+    hash_tables();
+    kernel_name = "scalar";
+    kernel = hash_scalar;
+    return kernel_name;
+}
+
+unsigned int hash_crc32c(unsigned int crc, const char *buf, size_t len){
+    if( ! kernel ){
+        hash_kernel();
+    }
+
+    return ~kernel(~crc, (const unsigned char *)buf, len);
+}
+
+/* multiply vector vec by 32x32 matrix mat over gf(2) */
+static unsigned int gf2_times(const unsigned int *mat, unsigned int vec){
+    unsigned int sum = 0;
+
+    for( ; vec; vec >>= 1, ++mat ){
+        if( vec & 1 ){
+            sum ^= *mat;
+        }
+    }
+
+    return sum;
+}
+
+/* square = mat * mat */
+static void gf2_square(unsigned int *square, const unsigned int *mat){
+    int n = 0;
+
+    for( n = 0; n < 32; ++n ){
+        square[n] = gf2_times(mat, mat[n]);
+    }
+}
+
+/* as zlib's crc32_combine, a's crc is run through len zero bytes
+ * by repeatedly squaring the operator for one zero bit
+ */
+unsigned int hash_combine(unsigned int a, unsigned int b, unsigned long long int len){
+    unsigned int even[32];
+    unsigned int odd[32];
+    unsigned int row = 1;
+    int n = 0;
+
+    if( ! len ){
+        return a;
+    }
+
+    /* operator for one zero bit */
+    odd[0] = HASH_POLY;
+    for( n = 1; n < 32; ++n ){
+        odd[n] = row;
+        row <<= 1;
+    }
+
+    /* two, then four zero bits */
+    gf2_square(even, odd);
+    gf2_square(odd, even);
+
+    /* each pass squares to the next power of two zero bytes,
+     * applying it where len has that bit set
+     */
+    do {
+        gf2_square(even, odd);
+        if( len & 1 ){
+            a = gf2_times(even, a);
+        }
+        len >>= 1;
+        if( ! len ){
+            break;
+        }
+
+        gf2_square(odd, even);
+        if( len & 1 ){
+            a = gf2_times(odd, a);
+        }
+        len >>= 1;
+    } while( len );
+
+    return a ^ b;
+}
@@ -0,0 +1,27 @@
+#ifndef DODO_HASH_H
+#define DODO_HASH_H
+
+#include <stddef.h> /* size_t */
+
+/* crc32c (castagnoli) checksums
+ *
+ * hash_crc32c continues crc over buf[0, len), start with crc 0
+ * so hash_crc32c(0, "123456789", 9) is 0xe3069283
+ *
+ * the sse4.2 crc32 instruction is used where the running cpu has it,
+ * otherwise tables are used 8 bytes at a time
+ */
+unsigned int hash_crc32c(unsigned int crc, const char *buf, size_t len);
+
+/* returns crc of a followed by b, given crc of each and the length of b
+ * lets pieces of a range be checksummed in parallel and joined in order
+ */
+unsigned int hash_combine(unsigned int a, unsigned int b, unsigned long long int len);
+
+/* name of kernel hash_crc32c dispatches to, "sse4.2" or "scalar"
+ * settles on it, and builds any tables it needs, so call it before
+ * starting threads that hash
+ */
+const char * hash_kernel(void);
+
+#endif
@@ -0,0 +1,531 @@
+#include <string.h> /* strcmp, memchr, memcmp */
+
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (*scan_fn)(const char *buf, size_t len, size_t *want);
+typedef size_t (*find_fn)(const struct Needle *needle, const char *hay, size_t len);
+typedef void (*hex_fn)(const char *buf, size_t len, char *out);
+
+/* Boyer-Moore-Horspool, needle must be at least 2 bytes
+ * also used for the tails of blocks the vector kernels leave behind
+ */
+static size_t scan_find_scalar(const struct Needle *needle, const char *hay, size_t len){
+    size_t last = needle->len - 1;
+    unsigned char end = needle->str[last];
+    unsigned char c = 0;
+    size_t i = 0;
+
+    while( i + last < len ){
+        c = hay[i + last];
+        if( c == end && ! memcmp(hay + i, needle->str, last) ){
+            return i;
+        }
+        i += needle->skip[c];
+    }
+
+    return SCAN_NONE;
+}
+
+/* Horspool run backwards, the window moves left keyed on the byte under its start
+ * needle must be at least 2 bytes
+ */
+static size_t scan_find_last_scalar(const struct Needle *needle, const char *hay, size_t len){
+    unsigned char start = needle->str[0];
+    unsigned char c = 0;
+    size_t i = 0;
+
+    if( needle->len > len ){
+        return SCAN_NONE;
+    }
+
+    for( i = len - needle->len; ; i -= needle->rskip[c] ){
+        c = hay[i];
+        if( c == start && ! memcmp(hay + i + 1, needle->str + 1, needle->len - 1) ){
+            return i;
+        }
+        if( i < needle->rskip[c] ){
+            break;
+        }
+    }
+
+    return SCAN_NONE;
+}
+
+/* portable byte at a time kernel
+ * also used for the tails of blocks the vector kernels leave behind
+ */
+static size_t scan_newlines_scalar(const char *buf, size_t len, size_t *want){
+    size_t i = 0;
+
+    for( i = 0; i < len; ++i ){
+        if( buf[i] == '\n' && --(*want) == 0 ){
+            return i + 1;
+        }
+    }
+
+    return len;
+}
+
+/* table lookup a byte at a time
+ * also used for the tails of blocks the vector kernels leave behind
+ */
+static void scan_hex_scalar(const char *buf, size_t len, char *out){
+    static const char digits[] = "0123456789abcdef";
+    size_t i = 0;
+
+    for( i = 0; i < len; ++i ){
+        out[2 * i] = digits[(unsigned char)buf[i] >> 4];
+        out[2 * i + 1] = digits[(unsigned char)buf[i] & 0x0f];
+    }
+}
+
+#ifdef SCAN_X86
+
+/* account for a mask of newline positions within a 64 byte block
+ * returns 1 and sets *at to the index of the wanted newline if it is in mask
+ * returns 0 after reducing *want otherwise
+ */
+static inline int scan_mask(unsigned long long mask, size_t *want, size_t *at){
+    size_t count = __builtin_popcountll(mask);
+
+    if( count < *want ){
+        *want -= count;
+        return 0;
+    }
+
+    /* drop the newlines before the one we want */
+    while( --(*want) ){
+        mask &= mask - 1;
+    }
+
+    *at = __builtin_ctzll(mask);
+    return 1;
+}
+
+/* sse2 is part of the x86_64 baseline */
+__attribute__((target("sse2")))
+static size_t scan_newlines_sse2(const char *buf, size_t len, size_t *want){
+    const __m128i nl = _mm_set1_epi8('\n');
+    unsigned long long mask = 0;
+    size_t at = 0;
+    size_t i = 0;
+    int j = 0;
+
+    for( i = 0; i + 64 <= len; i += 64 ){
+        mask = 0;
+        for( j = 0; j < 4; ++j ){
+            __m128i v = _mm_loadu_si128((const __m128i *)(buf + i + 16 * j));
+            mask |= (unsigned long long)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)) << (16 * j);
+        }
+
+        if( mask && scan_mask(mask, want, &at) ){
+            return i + at + 1;
+        }
+    }
+
+    return i + scan_newlines_scalar(buf + i, len - i, want);
+}
+
+__attribute__((target("avx2,popcnt,bmi")))
+static size_t scan_newlines_avx2(const char *buf, size_t len, size_t *want){
+    const __m256i nl = _mm256_set1_epi8('\n');
+    __m256i lo;
+    __m256i hi;
+    unsigned long long mask = 0;
+    size_t at = 0;
+    size_t i = 0;
+
+    for( i = 0; i + 64 <= len; i += 64 ){
+        lo = _mm256_loadu_si256((const __m256i *)(buf + i));
+        hi = _mm256_loadu_si256((const __m256i *)(buf + i + 32));
+        mask =   (unsigned long long)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, nl))
+             | ((unsigned long long)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, nl)) << 32);
+
+        if( mask && scan_mask(mask, want, &at) ){
+            return i + at + 1;
+        }
+    }
+
+    return i + scan_newlines_scalar(buf + i, len - i, want);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt,bmi")))
+static size_t scan_newlines_avx512(const char *buf, size_t len, size_t *want){
+    const __m512i nl = _mm512_set1_epi8('\n');
+    unsigned long long mask = 0;
+    size_t at = 0;
+    size_t i = 0;
+
+    for( i = 0; i + 64 <= len; i += 64 ){
+        mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(buf + i)), nl);
+
+        if( mask && scan_mask(mask, want, &at) ){
+            return i + at + 1;
+        }
+    }
+
+    return i + scan_newlines_scalar(buf + i, len - i, want);
+}
+
+/* vector hex encoding
+ * each byte is split into nibbles, which become digits by adding '0'
+ * and a further 'a' - '0' - 10 where they exceed 9,
+ * then high and low nibbles are interleaved into place
+ */
+__attribute__((target("sse2")))
+static void scan_hex_sse2(const char *buf, size_t len, char *out){
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i alpha = _mm_set1_epi8('a' - '0' - 10);
+    __m128i v;
+    __m128i hi;
+    __m128i lo;
+    size_t i = 0;
+
+    for( i = 0; i + 16 <= len; i += 16 ){
+        v = _mm_loadu_si128((const __m128i *)(buf + i));
+        hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        lo = _mm_and_si128(v, mask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha));
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    scan_hex_scalar(buf + i, len - i, out + 2 * i);
+}
+
+/* as sse2, but unpacking works within 128 bit lanes
+ * so the halves are put back in order before storing
+ */
+__attribute__((target("avx2")))
+static void scan_hex_avx2(const char *buf, size_t len, char *out){
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i alpha = _mm256_set1_epi8('a' - '0' - 10);
+    __m256i v;
+    __m256i hi;
+    __m256i lo;
+    __m256i first;
+    __m256i second;
+    size_t i = 0;
+
+    for( i = 0; i + 32 <= len; i += 32 ){
+        v = _mm256_loadu_si256((const __m256i *)(buf + i));
+        hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+        lo = _mm256_and_si256(v, mask);
+        hi = _mm256_add_epi8(_mm256_add_epi8(hi, zero), _mm256_and_si256(_mm256_cmpgt_epi8(hi, nine), alpha));
+        lo = _mm256_add_epi8(_mm256_add_epi8(lo, zero), _mm256_and_si256(_mm256_cmpgt_epi8(lo, nine), alpha));
+        first = _mm256_unpacklo_epi8(hi, lo);
+        second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+
+    scan_hex_scalar(buf + i, len - i, out + 2 * i);
+}
+
+/* vector substring search
+ * compares the first and last bytes of the needle against every position at once,
+ * only positions where both match are checked in full
+ * this runs close to memchr speed unless those two bytes are very common together
+ */
+
+/* check candidate positions set in mask, starting from hay + i */
+static inline size_t scan_candidates(const struct Needle *needle, const char *hay, size_t i, unsigned int mask){
+    size_t at = 0;
+
+    while( mask ){
+        at = i + __builtin_ctz(mask);
+        /* first and last bytes already match */
+        if( ! memcmp(hay + at + 1, needle->str + 1, needle->len - 2) ){
+            return at;
+        }
+        mask &= mask - 1;
+    }
+
+    return SCAN_NONE;
+}
+
+/* as scan_candidates but checks the highest candidate first */
+static inline size_t scan_candidates_last(const struct Needle *needle, const char *hay, size_t i, unsigned int mask){
+    size_t at = 0;
+
+    while( mask ){
+        at = i + 31 - __builtin_clz(mask);
+        if( ! memcmp(hay + at + 1, needle->str + 1, needle->len - 2) ){
+            return at;
+        }
+        mask &= ~(1u << (at - i));
+    }
+
+    return SCAN_NONE;
+}
+
+/* finish search from hay + i once fewer than a vector's worth of positions remain */
+static inline size_t scan_find_tail(const struct Needle *needle, const char *hay, size_t len, size_t i){
+    size_t at = scan_find_scalar(needle, hay + i, len - i);
+    return at == SCAN_NONE ? SCAN_NONE : i + at;
+}
+
+__attribute__((target("sse2")))
+static size_t scan_find_sse2(const struct Needle *needle, const char *hay, size_t len){
+    const __m128i first = _mm_set1_epi8(needle->str[0]);
+    const __m128i last = _mm_set1_epi8(needle->str[needle->len - 1]);
+    size_t end = needle->len - 1;
+    unsigned int mask = 0;
+    size_t at = 0;
+    size_t i = 0;
+
+    for( i = 0; i + end + 16 <= len; i += 16 ){
+        mask = _mm_movemask_epi8(_mm_and_si128(
+                   _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(hay + i)), first),
+                   _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(hay + i + end)), last)));
+
+        if( mask && (at = scan_candidates(needle, hay, i, mask)) != SCAN_NONE ){
+            return at;
+        }
+    }
+
+    return scan_find_tail(needle, hay, len, i);
+}
+
+__attribute__((target("sse2")))
+static size_t scan_find_last_sse2(const struct Needle *needle, const char *hay, size_t len){
+    const __m128i first = _mm_set1_epi8(needle->str[0]);
+    const __m128i last = _mm_set1_epi8(needle->str[needle->len - 1]);
+    size_t end = needle->len - 1;
+    unsigned int mask = 0;
+    size_t at = 0;
+    /* number of positions a match could still start at */
+    size_t top = len < needle->len ? 0 : len - end;
+
+    for( ; top >= 16; top -= 16 ){
+        mask = _mm_movemask_epi8(_mm_and_si128(
+                   _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(hay + top - 16)), first),
+                   _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(hay + top - 16 + end)), last)));
+
+        if( mask && (at = scan_candidates_last(needle, hay, top - 16, mask)) != SCAN_NONE ){
+            return at;
+        }
+    }
+
+    /* remaining positions are [0, top) */
+    return top ? scan_find_last_scalar(needle, hay, top + end) : SCAN_NONE;
+}
+
+__attribute__((target("avx2,popcnt,bmi")))
+static size_t scan_find_avx2(const struct Needle *needle, const char *hay, size_t len){
+    const __m256i first = _mm256_set1_epi8(needle->str[0]);
+    const __m256i last = _mm256_set1_epi8(needle->str[needle->len - 1]);
+    size_t end = needle->len - 1;
+    unsigned int mask = 0;
+    size_t at = 0;
+    size_t i = 0;
+
+    for( i = 0; i + end + 32 <= len; i += 32 ){
+        mask = _mm256_movemask_epi8(_mm256_and_si256(
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(hay + i)), first),
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(hay + i + end)), last)));
+
+        if( mask && (at = scan_candidates(needle, hay, i, mask)) != SCAN_NONE ){
+            return at;
+        }
+    }
+
+    return scan_find_tail(needle, hay, len, i);
+}
+
+__attribute__((target("avx2,popcnt,bmi")))
+static size_t scan_find_last_avx2(const struct Needle *needle, const char *hay, size_t len){
+    const __m256i first = _mm256_set1_epi8(needle->str[0]);
+    const __m256i last = _mm256_set1_epi8(needle->str[needle->len - 1]);
+    size_t end = needle->len - 1;
+    unsigned int mask = 0;
+    size_t at = 0;
+    /* number of positions a match could still start at */
+    size_t top = len < needle->len ? 0 : len - end;
+
+    for( ; top >= 32; top -= 32 ){
+        mask = _mm256_movemask_epi8(_mm256_and_si256(
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(hay + top - 32)), first),
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(hay + top - 32 + end)), last)));
+
+        if( mask && (at = scan_candidates_last(needle, hay, top - 32, mask)) != SCAN_NONE ){
+            return at;
+        }
+    }
+
+    /* remaining positions are [0, top) */
+    return top ? scan_find_last_scalar(needle, hay, top + end) : SCAN_NONE;
+}
+
+#endif /* SCAN_X86 */
+
+struct Kernel {
+    const char *name;
+    scan_fn fn;
+    find_fn find;
+    find_fn find_last;
+    hex_fn hex;
+};
+
+/* in order of preference */
+static const struct Kernel kernels[] = {
+#ifdef SCAN_X86
+    /* 64 byte masks buy nothing over avx2 for the few candidates search sees */
+    { "avx512", scan_newlines_avx512, scan_find_avx2, scan_find_last_avx2, scan_hex_avx2 },
+    { "avx2", scan_newlines_avx2, scan_find_avx2, scan_find_last_avx2, scan_hex_avx2 },
+    { "sse2", scan_newlines_sse2, scan_find_sse2, scan_find_last_sse2, scan_hex_sse2 },
+#endif
+    { "scalar", scan_newlines_scalar, scan_find_scalar, scan_find_last_scalar, scan_hex_scalar },
+    { 0, 0, 0, 0, 0 }
+};
+
+static const struct Kernel *kernel = 0;
+
+/* returns 1 if cpu can run kernel k */
+static int scan_supported(const struct Kernel *k){
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+
+    if( k->fn == scan_newlines_avx512 ){
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi");
+    }
+
+    if( k->fn == scan_newlines_avx2 ){
+        return __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi");
+    }
+
+    if( k->fn == scan_newlines_sse2 ){
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+
+    return 1;
+}
+
+int scan_select(const char *name){
+    const struct Kernel *k = 0;
+
+    for( k = kernels; k->name; ++k ){
+        if( ! strcmp(name, k->name) && scan_supported(k) ){
+            kernel = k;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* pick best kernel for this cpu */
+static const struct Kernel * scan_detect(void){
+    const struct Kernel *k = 0;
+
+    for( k = kernels; k->name; ++k ){
+        if( scan_supported(k) ){
+            return k;
+        }
+    }
+
+    /* unreachable as scalar is always supported */
+    return k - 1;
+}
+
+const char * scan_kernel(void){
+    if( ! kernel ){
+        kernel = scan_detect();
+    }
+
+    return kernel->name;
+}
+
+size_t scan_newlines(const char *buf, size_t len, size_t *want){
+    if( ! kernel ){
+        kernel = scan_detect();
+    }
+
+    return kernel->fn(buf, len, want);
+}
+
+void scan_needle(struct Needle *needle, const char *str, size_t len){
+    size_t i = 0;
+
+    needle->str = str;
+    needle->len = len;
+
+    for( i = 0; i < 256; ++i ){
+        needle->skip[i] = len;
+        needle->rskip[i] = len;
+    }
+
+    /* last byte is left out, it would only ever shift by 0 */
+    for( i = 0; i + 1 < len; ++i ){
+        needle->skip[(unsigned char)str[i]] = len - 1 - i;
+    }
+
+    /* likewise first byte, going backwards the occurrence nearest the start wins */
+    for( i = len - 1; i > 0; --i ){
+        needle->rskip[(unsigned char)str[i]] = i;
+    }
+}
+
+size_t scan_find(const struct Needle *needle, const char *hay, size_t len){
+    const char *found = 0;
+
+    if( needle->len > len ){
+        return SCAN_NONE;
+    }
+
+    if( needle->len == 1 ){
+        found = memchr(hay, needle->str[0], len);
+        return found ? (size_t)(found - hay) : SCAN_NONE;
+    }
+
+    if( ! kernel ){
+        kernel = scan_detect();
+    }
+
+    return kernel->find(needle, hay, len);
+}
+
+size_t scan_find_last(const struct Needle *needle, const char *hay, size_t len){
+    size_t i = 0;
+
+    if( needle->len > len ){
+        return SCAN_NONE;
+    }
+
+    /* memrchr is not portable */
+    if( needle->len == 1 ){
+        for( i = len; i > 0; --i ){
+            if( hay[i - 1] == needle->str[0] ){
+                return i - 1;
+            }
+        }
+        return SCAN_NONE;
+    }
+
+    if( ! kernel ){
+        kernel = scan_detect();
+    }
+
+    return kernel->find_last(needle, hay, len);
+}
+
+void scan_hex(const char *buf, size_t len, char *out){
+    if( ! kernel ){
+        kernel = scan_detect();
+    }
+
+    kernel->hex(buf, len, out);
+}
@@ -0,0 +1,80 @@
+#ifndef DODO_SCAN_H
+#define DODO_SCAN_H
+
+#include <stddef.h> /* size_t */
+
+/* newline scanning kernels
+ *
+ * scan_newlines counts newlines in buf[0, len) stopping at the *want-th one
+ *
+ * if the *want-th newline is found
+ *  *want is set to 0
+ *  returns the index just past that newline
+ * otherwise
+ *  *want is reduced by the number of newlines seen
+ *  returns len
+ *
+ * *want must be at least 1
+ * passing *want as (size_t)-1 counts every newline in buf
+ *
+ * the best kernel supported by the running cpu is picked on first use
+ */
+size_t scan_newlines(const char *buf, size_t len, size_t *want);
+
+/* name of kernel scan_newlines dispatches to */
+const char * scan_kernel(void);
+
+/* force scan_newlines to use the named kernel
+ * one of "scalar", "sse2", "avx2" or "avx512"
+ * returns 0 on success
+ * returns 1 if kernel is unknown or unsupported by this cpu
+ */
+int scan_select(const char *name);
+
+/* substring search
+ *
+ * vector kernels filter positions on the first and last bytes of the needle,
+ * the scalar kernel uses Boyer-Moore-Horspool which skips ahead by up to the
+ * length of the needle on every mismatch
+ * single byte needles are handed to memchr
+ */
+
+/* returned by scan_find when there is no match */
+#define SCAN_NONE ((size_t)-1)
+
+struct Needle {
+    const char *str;
+    size_t len;
+    /* distance to shift for each byte found under the end of the needle */
+    size_t skip[256];
+    /* distance to shift backwards for each byte found under its start */
+    size_t rskip[256];
+};
+
+/* prepare needle for searching for len bytes of str, len must be at least 1
+ * str is not copied so must outlive needle
+ */
+void scan_needle(struct Needle *needle, const char *str, size_t len);
+
+/* returns index of first match of needle within hay[0, len)
+ * returns SCAN_NONE if there is none
+ *
+ * like scan_newlines this uses the kernel picked for the running cpu
+ */
+size_t scan_find(const struct Needle *needle, const char *hay, size_t len);
+
+/* returns index of last match of needle within hay[0, len)
+ * returns SCAN_NONE if there is none
+ */
+size_t scan_find_last(const struct Needle *needle, const char *hay, size_t len);
+
+/* hex encoding
+ *
+ * writes len bytes of buf to out as 2 * len lowercase hex digits,
+ * high nibble first, out is not terminated
+ *
+ * like scan_newlines this uses the kernel picked for the running cpu
+ */
+void scan_hex(const char *buf, size_t len, char *out);
+
+#endif
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+
+# run each exhaustive test program against many copies of its input at once
+
+set -eu
+
+TESTS_DIR="t/tests/exhaustive"
+
+BATCHDIR=$(mktemp -d) || exit
+
+fail() {
+    echo "batch test failed: $1"
+    echo "leaving tmp dir laying around as '$BATCHDIR'"
+    exit 1
+}
+
+for opts in "-j 1" "-j 4" "-j 4 -x" "-j 4 -P" "-j 4 --mmap" "-j 4 --stdio"; do
+    for infile in $TESTS_DIR/*.in; do
+        base=${infile%.in}
+        echo "testing $base batched with '$opts'"
+
+        files=""
+        for k in 1 2 3 4 5 6 7 8 9 10; do
+            cp "$infile" "$BATCHDIR/$k"
+            files="$files $BATCHDIR/$k"
+        done
+
+        ./dodo $opts $files < "$base.dodo" > "$BATCHDIR/stdout" || fail "running $base with '$opts'"
+        for k in 1 2 3 4 5 6 7 8 9 10; do
+            cmp "$BATCHDIR/$k" "$base.out" || fail "$base with '$opts' left file $k different"
+        done
+        grep -q '^0 of 10 files failed$' "$BATCHDIR/stdout" || fail "$base with '$opts' summary"
+        rm -f "$BATCHDIR"/*
+    done
+done
+
+echo "testing failures are reported per file"
+printf 'hello world\n' > "$BATCHDIR/good"
+printf 'hello there\n' > "$BATCHDIR/bad"
+printf 'b6 e/world/ w/WORLD/' | ./dodo -j 2 "$BATCHDIR/good" "$BATCHDIR/bad" "$BATCHDIR/missing" > "$BATCHDIR/stdout" \
+    && fail "batch with failures succeeded"
+grep -q "^ok $BATCHDIR/good$" "$BATCHDIR/stdout" || fail "good file not reported ok"
+grep -q "^FAILED $BATCHDIR/bad$" "$BATCHDIR/stdout" || fail "bad file not reported failed"
+grep -q "^FAILED $BATCHDIR/missing$" "$BATCHDIR/stdout" || fail "missing file not reported failed"
+grep -q '^2 of 3 files failed$' "$BATCHDIR/stdout" || fail "summary of failures"
+printf 'hello WORLD\n' | cmp - "$BATCHDIR/good" || fail "good file not edited"
+printf 'hello there\n' | cmp - "$BATCHDIR/bad" || fail "bad file edited"
+
+echo "testing compiled program runs in batch"
+printf 'b0 w/HELLO/ r/W[A-Z]+/ e/WORLD/' | ./dodo --compile - -o "$BATCHDIR/compiled" || fail "compiling"
+./dodo --load "$BATCHDIR/compiled" -j 3 "$BATCHDIR/good" "$BATCHDIR/bad" > /dev/null \
+    && fail "compiled batch with failure succeeded"
+printf 'HELLO WORLD\n' | cmp - "$BATCHDIR/good" || fail "compiled program left good file wrong"
+
+echo "testing streaming refuses several files"
+printf 'b0' | ./dodo -s "$BATCHDIR/good" "$BATCHDIR/bad" > /dev/null && fail "streamed batch was run"
+
+rm -r "$BATCHDIR"
+
+echo "batch testing completed successfully"
@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+
+# compile each exhaustive test program and run it again loaded from that
+
+set -eu
+
+TESTS_DIR="t/tests/exhaustive"
+
+COMPILED=$(mktemp) || exit
+TESTFILE=$(mktemp) || exit
+
+fail() {
+    echo "compile test failed: $1"
+    echo "leaving tmp files laying around as '$COMPILED' and '$TESTFILE'"
+    exit 1
+}
+
+for infile in $TESTS_DIR/*.in; do
+    base=${infile%.in}
+    echo "testing $base compiled"
+
+    ./dodo --compile "$base.dodo" -o "$COMPILED" || fail "compiling $base"
+    cp "$infile" "$TESTFILE"
+    ./dodo --load "$COMPILED" "$TESTFILE" > "$TESTFILE.stdout" || fail "running compiled $base"
+    cmp "$TESTFILE" "$base.out" || fail "compiled $base left file different"
+    if [ -e "$base.stdout" ]; then
+        cmp "$TESTFILE.stdout" "$base.stdout" || fail "compiled $base printed differently"
+    fi
+done
+rm "$TESTFILE.stdout"
+
+echo "testing program compiled from stdin"
+printf 'hello world\n' > "$TESTFILE"
+printf 'b6 e/world/ w/there/' | ./dodo --compile - -o "$COMPILED" || fail "compiling stdin"
+./dodo --load "$COMPILED" "$TESTFILE" || fail "running program compiled from stdin"
+printf 'hello there\n' | cmp - "$TESTFILE" || fail "program compiled from stdin left file wrong"
+
+echo "testing damaged compiled program is refused"
+printf 'X' | dd of="$COMPILED" bs=1 seek=60 conv=notrunc 2> /dev/null
+./dodo --load "$COMPILED" "$TESTFILE" > /dev/null && fail "damaged program was run"
+printf 'hello there\n' | cmp - "$TESTFILE" || fail "damaged program changed file"
+
+# set the 8 bytes at offset $2 of compiled program $1 to -1
+# and fix up the checksum after the 40 byte header, so only validation can refuse it
+forge() {
+    local hash=$((0xcbf29ce484222325)) byte k out=
+    printf '\xff\xff\xff\xff\xff\xff\xff\xff' | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+    for byte in $(tail -c +41 "$1" | od -A n -v -t u1); do
+        hash=$(( (hash ^ byte) * 0x100000001b3 ))
+    done
+    for k in 0 1 2 3 4 5 6 7; do
+        out+=$(printf '\\x%02x' $(( (hash >> (8 * k)) & 0xff )))
+    done
+    printf "$out" | dd of="$1" bs=1 seek=32 conv=notrunc 2> /dev/null
+}
+
+# the first record follows the header, its num at byte 40 and str at byte 48
+echo "testing compiled program missing a string is refused"
+printf 'e/hello/' | ./dodo --compile - -o "$COMPILED" || fail "compiling expect"
+./dodo --load "$COMPILED" "$TESTFILE" || fail "running compiled expect"
+forge "$COMPILED" 48
+./dodo --load "$COMPILED" "$TESTFILE" | grep -q "is invalid" || fail "expect without string was not refused"
+
+echo "testing compiled program with a bad line number is refused"
+printf 'l1' | ./dodo --compile - -o "$COMPILED" || fail "compiling line"
+./dodo --load "$COMPILED" "$TESTFILE" || fail "running compiled line"
+forge "$COMPILED" 40
+./dodo --load "$COMPILED" "$TESTFILE" | grep -q "is invalid" || fail "line -1 was not refused"
+
+echo "testing program text is refused"
+./dodo --load "$TESTS_DIR/write.dodo" "$TESTFILE" > /dev/null && fail "program text was run"
+
+echo "testing program failing to parse is not compiled"
+printf 'b0 z' | ./dodo --compile - -o "$COMPILED" > /dev/null && fail "bad program compiled"
+
+rm "$COMPILED" "$TESTFILE"
+
+echo "compile testing completed successfully"
@@ -0,0 +1,76 @@
+#!/usr/bin/env bash
+
+# copy other files into a file with f/path/
+
+set -eu
+
+TESTFILE=$(mktemp) || exit
+PAYLOAD=$(mktemp) || exit
+
+fail() {
+    echo "copy test failed: $1"
+    echo "leaving tmp files laying around as '$TESTFILE' and '$PAYLOAD'"
+    exit 1
+}
+
+# slashes in the path are escaped as in any other string
+ESCAPED=$(printf '%s' "$PAYLOAD" | sed 's|/|\\/|g')
+
+head -c 5000000 /dev/urandom > "$PAYLOAD"
+
+for opts in "" "--mmap" "--stdio" "-x" "-s"; do
+    echo "testing copying a large range with '$opts'"
+    seq 1 100000 > "$TESTFILE"
+    printf 'l50001 f/%s/1000,4000000' "$ESCAPED" | ./dodo $opts "$TESTFILE" || fail "copying with '$opts'"
+    {
+        seq 1 50000
+        tail -c +1001 "$PAYLOAD" | head -c 4000000
+    } | cmp - "$TESTFILE" || fail "copy with '$opts' left file wrong"
+    rm -f "$TESTFILE.dodoidx"
+done
+
+echo "testing line index is correct after copying newlines in"
+seq 1 5000 > "$TESTFILE"
+seq 1 5000 | sed 's/^/copy /' > "$PAYLOAD"
+./dodo -x "$TESTFILE" <<EOF || fail "building index"
+l5000
+e/5000/
+EOF
+./dodo -x "$TESTFILE" <<EOF || fail "copying with index"
+l2000
+f/$ESCAPED/
+l4000
+e/copy 2001
+/
+EOF
+./dodo -x "$TESTFILE" <<EOF || fail "seeking after copy"
+l6999
+e/copy 5000
+/
+EOF
+rm -f "$TESTFILE.dodoidx"
+
+echo "testing a range past the end of the payload is refused"
+printf 'hello world\n' > "$TESTFILE"
+printf 'payload' > "$PAYLOAD"
+printf 'f/%s/3,5' "$ESCAPED" | ./dodo "$TESTFILE" > /dev/null && fail "range past end was copied"
+printf 'f/%s/8' "$ESCAPED" | ./dodo "$TESTFILE" > /dev/null && fail "start past end was copied"
+printf 'f/%s/7' "$ESCAPED" | ./dodo "$TESTFILE" || fail "empty range at end was refused"
+printf 'hello world\n' | cmp - "$TESTFILE" || fail "refused copy changed file"
+
+echo "testing pending edits are applied before copying"
+printf 'b0 i/>>/ b4 f/%s/0,3 d' "$ESCAPED" | ./dodo "$TESTFILE" || fail "copying after insert"
+printf '>>hepayworld\n' | cmp - "$TESTFILE" || fail "copy after insert left file wrong"
+
+echo "testing copying a file over itself"
+ESCAPED=$(printf '%s' "$TESTFILE" | sed 's|/|\\/|g')
+printf 'b0 f/%s/2,4' "$ESCAPED" | ./dodo "$TESTFILE" > /dev/null && fail "overlapping copy was made"
+printf 'b8 f/%s/2,4' "$ESCAPED" | ./dodo "$TESTFILE" || fail "copy within file was refused"
+printf '>>hepaywhepa\n' | cmp - "$TESTFILE" || fail "copy within file left it wrong"
+
+echo "testing missing file"
+printf 'f/no\\/such\\/file/' | ./dodo "$TESTFILE" > /dev/null && fail "missing file was copied"
+
+rm "$TESTFILE" "$PAYLOAD"
+
+echo "copy testing completed successfully"
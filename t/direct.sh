@@ -0,0 +1,66 @@
+#!/usr/bin/env bash
+
+# check --direct keeps the file out of the page cache, where the file system has O_DIRECT
+# the engine tests run everything else through it
+
+set -eu
+
+TESTFILE=$(mktemp) || exit
+
+fail() {
+    echo "direct test failed: $1"
+    echo "leaving tmp file laying around as '$TESTFILE'"
+    exit 1
+}
+
+if ! command -v fincore > /dev/null; then
+    echo "direct testing skipped, fincore is required"
+    exit 0
+fi
+
+seq -w 1 2000000 > "$TESTFILE"
+dd if="$TESTFILE" iflag=nocache count=0 status=none
+
+if [ "$(fincore -n -o PAGES "$TESTFILE")" -ne 0 ]; then
+    echo "direct testing skipped, page cache of '$TESTFILE' cannot be dropped"
+    exit 0
+fi
+
+for opts in "" "-j 4"; do
+    echo "testing scans leave the page cache empty with '$opts'"
+    ./dodo --direct $opts "$TESTFILE" <<EOF > /dev/null || fail "scanning with '$opts'"
+l1999999
+e/1999999
+/
+l\$
+e/2000000
+/
+b0
+h
+/1999998/
+r/19+8\n/
+e/1999998
+/
+EOF
+    [ "$(fincore -n -o PAGES "$TESTFILE")" -eq 0 ] || fail "scanning with '$opts' left pages in the page cache"
+done
+
+echo "testing unaligned writes keep the bytes around them"
+./dodo --direct "$TESTFILE" <<EOF || fail "unaligned writes"
+b4094
+w/abcdef/
+b15999996
+w/xyz/
+w/tail/
+EOF
+[ "$(fincore -n -o PAGES "$TESTFILE")" -eq 0 ] || fail "writing left pages in the page cache"
+{
+    seq -w 1 2000000 | head -c 4094
+    printf 'abcdef'
+    seq -w 1 2000000 | head -c 15999996 | tail -c +4101
+    printf 'xyztail'
+} | cmp - "$TESTFILE" || fail "unaligned writes left file wrong"
+
+rm "$TESTFILE"
+
+echo "direct testing completed successfully"
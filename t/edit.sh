@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+
+# inserts and deletes shifting a file spanning many blocks
+# set DODO to run these through a different dodo command line
+
+set -eu
+
+DODO=${DODO:-./dodo}
+
+TESTFILENAME=$(mktemp) || exit
+EXPECTED=$(mktemp) || exit
+
+fail() {
+    echo "edit test failed: $1"
+    echo "leaving tmp files laying around as '$TESTFILENAME' and '$EXPECTED'"
+    exit 1
+}
+
+# every line is 7 bytes so line n starts at byte 7 * (n - 1)
+reset() {
+    seq -w 1 600000 > "$TESTFILENAME"
+}
+
+# program editing every 20000th line from the end back,
+# so offsets before each edit are as on disk
+# $1 is the command for each line
+edits() {
+    local n
+    for (( n = 600000; n > 0; n -= 20000 )); do
+        echo "b$(( 7 * (n - 1) ))"
+        echo "$1"
+    done
+}
+
+echo "testing inserts growing the file"
+reset
+edits "i/new /" | $DODO "$TESTFILENAME" || fail "inserts"
+seq -w 1 600000 | sed '0~20000 s/^/new /' > "$EXPECTED"
+cmp "$TESTFILENAME" "$EXPECTED" || fail "inserts left file wrong"
+
+echo "testing deletes shrinking the file"
+reset
+edits "d3" | $DODO "$TESTFILENAME" || fail "deletes"
+seq -w 1 600000 | sed '0~20000 s/^...//' > "$EXPECTED"
+cmp "$TESTFILENAME" "$EXPECTED" || fail "deletes left file wrong"
+
+echo "testing inserts and deletes mixed"
+reset
+edits "d7
+i/gone
+/" | $DODO "$TESTFILENAME" || fail "mixed"
+seq -w 1 600000 | sed '0~20000 s/^.*$/gone/' > "$EXPECTED"
+cmp "$TESTFILENAME" "$EXPECTED" || fail "mixed left file wrong"
+
+echo "testing line motions after edits"
+reset
+$DODO "$TESTFILENAME" <<'EOF2' || fail "line motions after edits"
+b0
+d700000
+l$
+e/600000
+/
+l1
+e/100001
+/
+b7
+i/inserted
+/
+l3
+e/100002
+/
+l$-500000
+e/100001
+/
+EOF2
+
+rm "$TESTFILENAME" "$EXPECTED"
+
+echo "edit testing completed successfully"
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# run exhaustive, interactive, line motion, search and edit tests again
+# through each engine other than the default pread engine
+
+for engine in --mmap --stdio --uring --direct; do
+    TESTS_DIR="t/tests/exhaustive/"
+    TEST_CMD="./dodo $engine"
+
+    source t/harness.sh
+
+    TESTS_DIR="t/tests/interactive/"
+    TEST_CMD="./dodo $engine -i"
+
+    source t/harness.sh
+
+    DODO="./dodo $engine" ./t/lines.sh || exit 1
+    DODO="./dodo $engine" ./t/search.sh || exit 1
+    DODO="./dodo $engine" ./t/edit.sh || exit 1
+done
+
+echo "engine testing completed successfully"
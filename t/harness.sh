@@ -65,5 +65,7 @@ for infile in $TESTS_DIR/*.in; do
 
     rm $testfile
     rm $teststdout
+    # remove line index if dodo was run with one
+    rm -f "$testfile.dodoidx"
 done
 
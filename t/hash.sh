@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+
+# checksum large ranges with h and e#hash#, split between workers or not
+
+set -eu
+
+TESTFILE=$(mktemp) || exit
+
+fail() {
+    echo "hash test failed: $1"
+    echo "leaving tmp file laying around as '$TESTFILE'"
+    exit 1
+}
+
+seq 1 3000000 | sed 's/^/row /' > "$TESTFILE"
+
+echo "testing checksum of whole file sequentially"
+EXPECTED=$(printf 'h' | ./dodo "$TESTFILE") || fail "hashing whole file"
+RANGE=$(printf 'b1234567 h20000000' | ./dodo "$TESTFILE") || fail "hashing range"
+
+for opts in "" "-j 2" "-j 3" "-j 8" "-j 3 --mmap" "-j 3 --stdio"; do
+    echo "testing checksums with '$opts'"
+    [ "$(printf 'h' | ./dodo $opts "$TESTFILE")" = "$EXPECTED" ] || fail "whole file with '$opts' differs"
+    [ "$(printf 'b1234567 h20000000' | ./dodo $opts "$TESTFILE")" = "$RANGE" ] || fail "range with '$opts' differs"
+    printf 'b0 %s b1234567 %s' "$EXPECTED" "$RANGE" | ./dodo $opts "$TESTFILE" || fail "expecting checksums with '$opts'"
+done
+
+echo "testing mismatch stops the program"
+printf 'b0 e#0#100 w/changed/' | ./dodo -j 4 "$TESTFILE" > /dev/null && fail "mismatch succeeded"
+[ "$(printf 'h' | ./dodo "$TESTFILE")" = "$EXPECTED" ] || fail "mismatch changed file"
+
+echo "testing pending edits are applied before checksumming"
+printf 'b0 w/ROW/ b0 h' | ./dodo "$TESTFILE" > /dev/null || fail "hashing after write"
+printf 'b0 w/row/' | ./dodo "$TESTFILE" || fail "restoring file"
+[ "$(printf 'h' | ./dodo "$TESTFILE")" = "$EXPECTED" ] || fail "restored file differs"
+printf 'b0 w/ROW/ b0 %s' "$EXPECTED" | ./dodo -j 4 "$TESTFILE" > /dev/null && fail "checksum missed pending write"
+
+echo "testing count past the end of the file is refused"
+printf '123456789' > "$TESTFILE"
+printf 'e#e3069283#9' | ./dodo "$TESTFILE" || fail "check value"
+printf 'e#e3069283#10' | ./dodo "$TESTFILE" > /dev/null && fail "count past end succeeded"
+
+echo "testing malformed checksums are refused"
+printf 'e#123456789#9' | ./dodo "$TESTFILE" > /dev/null && fail "9 digit checksum parsed"
+printf 'e##9' | ./dodo "$TESTFILE" > /dev/null && fail "empty checksum parsed"
+printf 'e#12g#9' | ./dodo "$TESTFILE" > /dev/null && fail "non hex checksum parsed"
+
+rm "$TESTFILE"
+
+echo "hash testing completed successfully"
@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+
+# run exhaustive tests again with line index enabled
+TESTS_DIR="t/tests/exhaustive/"
+TEST_CMD="./dodo -x"
+
+source t/harness.sh
+
+# then exercise checkpoints on a file spanning many index intervals
+
+set -eu
+
+TESTFILENAME=$(mktemp) || exit
+INDEXFILENAME="$TESTFILENAME.dodoidx"
+
+fail() {
+    echo "index test failed: $1"
+    echo "leaving tmp files laying around as '$TESTFILENAME' and '$INDEXFILENAME'"
+    exit 1
+}
+
+seq 1 5000 | sed 's/^/line /' > "$TESTFILENAME"
+
+echo "testing line index is created"
+./dodo -x "$TESTFILENAME" <<EOF || fail "first run"
+l4000
+e/line 4000
+/
+l1025
+e/line 1025
+/
+EOF
+[ -e "$INDEXFILENAME" ] || fail "index not written"
+
+echo "testing line index is reused"
+./dodo -x "$TESTFILENAME" <<EOF || fail "second run"
+l4096
+e/line 4096
+/
+l2
+e/line 2
+/
+EOF
+
+echo "testing writes moving newlines invalidate line index"
+./dodo -x "$TESTFILENAME" <<EOF || fail "third run"
+l2000
+e/line 2000
+/
+l10
+w/line
+10/
+l2000
+e/line 1999
+/
+EOF
+
+echo "testing writes keeping newlines preserve line index"
+./dodo -x "$TESTFILENAME" <<EOF || fail "fourth run"
+l3000
+w/LINE/
+l3000
+e/LINE 2999
+/
+EOF
+
+echo "testing truncate invalidates line index"
+./dodo -x "$TESTFILENAME" <<EOF || fail "fifth run"
+l2500
+t
+l2500
+e//
+EOF
+./dodo -x "$TESTFILENAME" <<EOF && fail "seeking past truncated end succeeded"
+l3000
+EOF
+
+echo "testing modified file discards stale line index"
+sed -i 's/^line 1$/line 1\nline 0/' "$TESTFILENAME"
+./dodo -x "$TESTFILENAME" <<EOF || fail "sixth run"
+l1026
+e/line 1024
+/
+EOF
+
+rm -f -- "$TESTFILENAME" "$INDEXFILENAME"
+
+echo "index testing completed successfully"
@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+
+# run exhaustive tests again with parallel line seeks
+TESTS_DIR="t/tests/exhaustive/"
+TEST_CMD="./dodo -j 4"
+
+source t/harness.sh
+
+# then seek through a file spanning many rounds of chunks
+
+set -eu
+
+TESTFILENAME=$(mktemp) || exit
+
+fail() {
+    echo "jobs test failed: $1"
+    echo "leaving tmp file laying around as '$TESTFILENAME'"
+    exit 1
+}
+
+seq 1 3000000 | sed 's/^/row /' > "$TESTFILENAME"
+
+for opts in "-j 1" "-j 2" "-j 3" "-j 3 -x" "-j 3 -x" "-x"; do
+    echo "testing line seeks with '$opts'"
+    ./dodo $opts "$TESTFILENAME" <<EOF || fail "seeking with '$opts'"
+l2999999
+e/row 2999999
+/
+l3000000
+e/row 3000000
+/
+l1
+e/row 1
+/
+l1500001
+e/row 1500001
+/
+l3000001
+e//
+EOF
+    ./dodo $opts "$TESTFILENAME" <<EOF && fail "seeking past end of file succeeded with '$opts'"
+l3000002
+EOF
+done
+
+# every line but the first starts with a match, so some straddle the
+# boundaries between workers whatever the number of jobs
+sed '2,$s/^row /ROW /' "$TESTFILENAME" > "$TESTFILENAME.expected"
+cp "$TESTFILENAME" "$TESTFILENAME.original"
+# a byte offset is known ahead, so the expect after substituting may be prefetched before it runs
+OFFSET=$(head -n 1999999 "$TESTFILENAME" | wc -c)
+
+for opts in "-j 1" "-j 2" "-j 3" "-j 7" "-j 4 --mmap" "-j 5 --stdio" "-j 4 --uring" "-j 3 -x"; do
+    echo "testing substitution with '$opts'"
+    ./dodo $opts "$TESTFILENAME" <<EOF > "$TESTFILENAME.out" || fail "substituting with '$opts'"
+s/
+row /
+ROW /g
+b$OFFSET
+e/ROW 2000000
+/
+EOF
+    grep -q '^2999999 matches, ' "$TESTFILENAME.out" || fail "wrong match count with '$opts'"
+    cmp -s "$TESTFILENAME" "$TESTFILENAME.expected" || fail "wrong substitution with '$opts'"
+
+    ./dodo $opts "$TESTFILENAME" <<'EOF' > /dev/null || fail "substituting back with '$opts'"
+s/
+ROW /
+row /g
+l2999999
+e/row 2999999
+/
+EOF
+    cmp -s "$TESTFILENAME" "$TESTFILENAME.original" || fail "wrong substitution back with '$opts'"
+done
+
+rm -f -- "$TESTFILENAME" "$TESTFILENAME.dodoidx" "$TESTFILENAME.expected" "$TESTFILENAME.original" "$TESTFILENAME.out"
+
+echo "jobs testing completed successfully"
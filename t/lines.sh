@@ -0,0 +1,74 @@
+#!/usr/bin/env bash
+
+# line motions over a file spanning many blocks
+# set DODO to run these through a different dodo command line
+
+set -eu
+
+DODO=${DODO:-./dodo}
+
+TESTFILENAME=$(mktemp) || exit
+
+fail() {
+    echo "lines test failed: $1"
+    echo "leaving tmp file laying around as '$TESTFILENAME'"
+    exit 1
+}
+
+seq 1 600000 | sed 's/^/row /' > "$TESTFILENAME"
+
+echo "testing motions from end of file"
+$DODO "$TESTFILENAME" <<'EOF' || fail "motions from end"
+l$
+e/row 600000
+/
+l$-1
+e/row 599999
+/
+l$-599999
+e/row 1
+/
+l$-300000
+e/row 300000
+/
+EOF
+
+echo "testing motions from cursor"
+$DODO "$TESTFILENAME" <<'EOF' || fail "motions from cursor"
+l1000
+l+1
+e/row 1001
+/
+l+250000
+e/row 251001
+/
+l-251000
+e/row 1
+/
+l$
+l-400000
+e/row 200000
+/
+l+399999
+e/row 599999
+/
+l+2
+e//
+EOF
+
+echo "testing motions beyond file fail"
+$DODO "$TESTFILENAME" <<'EOF' && fail "moving before start of file succeeded"
+l10
+l-10
+EOF
+$DODO "$TESTFILENAME" <<'EOF' && fail "moving after end of file succeeded"
+l$
+l+2
+EOF
+$DODO "$TESTFILENAME" <<'EOF' && fail "moving before start of file from end succeeded"
+l$-600000
+EOF
+
+rm -f -- "$TESTFILENAME"
+
+echo "lines testing completed successfully"
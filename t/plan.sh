@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+
+# run exhaustive tests again through the offset sorted planner
+TESTS_DIR="t/tests/exhaustive/"
+TEST_CMD="./dodo --plan"
+
+source t/harness.sh
+
+# then compare planned and in order runs of a script patching scattered offsets
+# set DODO to run these through a different dodo command line
+
+set -eu
+
+DODO=${DODO:-./dodo}
+
+INORDER=$(mktemp) || exit
+PLANNED=$(mktemp) || exit
+PROGRAM=$(mktemp) || exit
+
+fail() {
+    echo "plan test failed: $1"
+    echo "leaving tmp files laying around as '$INORDER', '$PLANNED' and '$PROGRAM'"
+    exit 1
+}
+
+# every line is 7 bytes so line n starts at byte 7 * (n - 1)
+reset() {
+    seq -w 1 600000 > "$INORDER"
+    cp "$INORDER" "$PLANNED"
+}
+
+# patches of lines in scrambled order, some overlapping earlier ones
+# so their expects depend on what was written before
+awk 'BEGIN {
+    for( k = 0; k < 20000; ++k ){
+        n = (k * 7919) % 600000 + 1
+        printf "b%d\ne/%06d/\nw/x%05d/\n", 7 * (n - 1), n, k % 100000
+        if( k % 10 == 0 ){
+            printf "b%d\ne/x%05d\n/\nw/y/\n", 7 * (n - 1), k % 100000
+        }
+    }
+}' > "$PROGRAM"
+
+echo "testing planned patches match patches in order"
+reset
+$DODO "$INORDER" < "$PROGRAM" || fail "patches in order"
+$DODO --plan "$PLANNED" < "$PROGRAM" || fail "planned patches"
+cmp "$INORDER" "$PLANNED" || fail "planned patches left file different"
+
+echo "testing planned patches stop where an expect fails in order"
+reset
+echo "b0
+e/nope/
+w/late/" >> "$PROGRAM"
+echo "b14
+w/after failure
+/" >> "$PROGRAM"
+$DODO "$INORDER" < "$PROGRAM" > /dev/null && fail "patches in order succeeded"
+$DODO --plan "$PLANNED" < "$PROGRAM" > /dev/null && fail "planned patches succeeded"
+cmp "$INORDER" "$PLANNED" || fail "failed planned patches left file different"
+
+echo "testing cursor after planned stretch"
+reset
+$DODO --plan "$PLANNED" <<'EOF2' || fail "cursor after planned stretch"
+b70
+w/a/
+b7
+w/bc/
+e/0002
+/
+p1
+l+1
+e/000003
+/
+EOF2
+
+rm "$INORDER" "$PLANNED" "$PROGRAM"
+
+echo "plan testing completed successfully"
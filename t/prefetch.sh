@@ -0,0 +1,76 @@
+#!/usr/bin/env bash
+
+# run exhaustive tests again without prefetching
+TESTS_DIR="t/tests/exhaustive/"
+TEST_CMD="./dodo --no-prefetch"
+
+source t/harness.sh
+
+# then check prefetching leaves scattered patches as running without it does
+
+set -eu
+
+PLAIN=$(mktemp) || exit
+PREFETCHED=$(mktemp) || exit
+PROGRAM=$(mktemp) || exit
+
+fail() {
+    echo "prefetch test failed: $1"
+    echo "leaving tmp files laying around as '$PLAIN', '$PREFETCHED' and '$PROGRAM'"
+    exit 1
+}
+
+# every line is 7 bytes so line n starts at byte 7 * (n - 1)
+reset() {
+    seq -w 1 600000 > "$PLAIN"
+    cp "$PLAIN" "$PREFETCHED"
+}
+
+# patches of lines in scrambled order, with line motions and searches between
+# so the cursor is sometimes unknown ahead of time, and prints that run off the end
+awk 'BEGIN {
+    for( k = 0; k < 5000; ++k ){
+        n = (k * 7919) % 600000 + 1
+        printf "b%d\ne/%06d/\nw/x%05d/\np3\n", 7 * (n - 1), n, k % 100000
+        if( k % 10 == 0 ){
+            printf "l%d\ne/%06d/\nh7\n", n + 1, n + 1
+        }
+        if( k % 17 == 0 ){
+            printf "/%06d/\nw/y/\n", (n + 5) % 600000 + 1
+        }
+    }
+    printf "b%d\np20\n", 7 * 600000 - 3
+}' > "$PROGRAM"
+
+for opts in "" "--mmap" "--stdio" "--uring" "--uring -P" "-P" "-j 4"; do
+    echo "testing prefetching with '$opts'"
+    reset
+    ./dodo --no-prefetch $opts "$PLAIN" < "$PROGRAM" > "$PLAIN.out" || fail "running without prefetch with '$opts'"
+    ./dodo $opts "$PREFETCHED" < "$PROGRAM" > "$PREFETCHED.out" || fail "running with prefetch with '$opts'"
+    cmp "$PLAIN" "$PREFETCHED" || fail "prefetching with '$opts' changed the result"
+    cmp "$PLAIN.out" "$PREFETCHED.out" || fail "prefetching with '$opts' changed the output"
+done
+rm "$PLAIN.out" "$PREFETCHED.out"
+
+# pages only read are dropped once done with, where the file system lets them be
+if command -v fincore > /dev/null; then
+    seq -w 1 600000 > "$PREFETCHED"
+    awk 'BEGIN {
+        for( k = 0; k < 500; ++k ){
+            n = (k * 7919) % 600000 + 1
+            printf "b%d\ne/%06d/\n", 7 * (n - 1), n
+        }
+    }' > "$PROGRAM"
+    dd if="$PREFETCHED" iflag=nocache count=0 status=none
+    if [ "$(fincore -n -o PAGES "$PREFETCHED")" -eq 0 ]; then
+        echo "testing pages read are dropped"
+        ./dodo "$PREFETCHED" < "$PROGRAM" || fail "running expects"
+        [ "$(fincore -n -o PAGES "$PREFETCHED")" -lt 16 ] || fail "pages read were kept"
+        ./dodo --no-prefetch "$PREFETCHED" < "$PROGRAM" || fail "running expects without prefetch"
+        [ "$(fincore -n -o PAGES "$PREFETCHED")" -ge 400 ] || fail "pages read without prefetch were dropped"
+    fi
+fi
+
+rm "$PLAIN" "$PREFETCHED" "$PROGRAM"
+
+echo "prefetch testing completed successfully"
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+
+# print, raw and hexdump over more than fits in one chunk
+
+set -eu
+
+TESTFILE=$(mktemp) || exit
+OUTPUT=$(mktemp) || exit
+
+fail() {
+    echo "print test failed: $1"
+    echo "leaving tmp files laying around as '$TESTFILE' and '$OUTPUT'"
+    exit 1
+}
+
+head -c 3000000 /dev/urandom > "$TESTFILE"
+
+for opts in "" "--mmap" "--stdio"; do
+    echo "testing raw with '$opts' to a file and a pipe"
+    printf 'c3000000' | ./dodo $opts "$TESTFILE" > "$OUTPUT" || fail "raw to file with '$opts'"
+    cmp "$OUTPUT" "$TESTFILE" || fail "raw to file with '$opts' differs"
+    printf 'c3000000' | ./dodo $opts "$TESTFILE" | cat > "$OUTPUT" || fail "raw to pipe with '$opts'"
+    cmp "$OUTPUT" "$TESTFILE" || fail "raw to pipe with '$opts' differs"
+
+    echo "testing print with '$opts'"
+    printf 'p3000000' | ./dodo $opts "$TESTFILE" > "$OUTPUT" || fail "print with '$opts'"
+    { printf "'"; cat "$TESTFILE"; printf "'\n"; } | cmp - "$OUTPUT" || fail "print with '$opts' differs"
+
+    echo "testing hexdump with '$opts'"
+    printf 'b1000 x2000000' | ./dodo $opts "$TESTFILE" > "$OUTPUT" || fail "hexdump with '$opts'"
+    [ "$(head -c 16 "$OUTPUT")" = "00000000000003e8" ] || fail "hexdump with '$opts' starts at wrong offset"
+    [ "$(wc -l < "$OUTPUT")" -eq 62500 ] || fail "hexdump with '$opts' has wrong number of lines"
+    cut -c 19- "$OUTPUT" | tr -d '\n' > "$OUTPUT.digits"
+    tail -c +1001 "$TESTFILE" | head -c 2000000 | od -An -v -tx1 | tr -d ' \n' | cmp - "$OUTPUT.digits" \
+        || fail "hexdump with '$opts' differs"
+done
+
+echo "testing raw and hexdump see pending edits"
+printf 'b10 i/inserted/ b0 c3000008' | ./dodo "$TESTFILE" > "$OUTPUT" || fail "raw with pending insert"
+cmp "$OUTPUT" "$TESTFILE" || fail "raw with pending insert differs"
+printf 'b10 d8 b0 x3000000' | ./dodo "$TESTFILE" > "$OUTPUT" || fail "hexdump with pending delete"
+cut -c 19- "$OUTPUT" | tr -d '\n' > "$OUTPUT.digits"
+od -An -v -tx1 "$TESTFILE" | tr -d ' \n' | cmp - "$OUTPUT.digits" || fail "hexdump with pending delete differs"
+
+echo "testing counts past the end of the file stop there"
+printf 'c2000000000' | ./dodo "$TESTFILE" > "$OUTPUT" || fail "raw past end"
+cmp "$OUTPUT" "$TESTFILE" || fail "raw past end differs"
+
+rm "$TESTFILE" "$OUTPUT" "$OUTPUT.digits"
+
+echo "print testing completed successfully"
@@ -0,0 +1,94 @@
+#!/usr/bin/env bash
+
+# searches over a file spanning many blocks
+# set DODO to run these through a different dodo command line
+
+set -eu
+
+DODO=${DODO:-./dodo}
+
+TESTFILENAME=$(mktemp) || exit
+
+fail() {
+    echo "search test failed: $1"
+    echo "leaving tmp file laying around as '$TESTFILENAME'"
+    exit 1
+}
+
+# first needle straddles the first 1MB block boundary
+head -c 1048574 /dev/zero | tr '\0' 'a' > "$TESTFILENAME"
+printf 'NEEDLE' >> "$TESTFILENAME"
+head -c 3000000 /dev/zero | tr '\0' 'b' >> "$TESTFILENAME"
+printf 'NEEDLE2\n' >> "$TESTFILENAME"
+
+echo "testing forward search across blocks"
+$DODO "$TESTFILENAME" <<'EOF' || fail "forward search"
+/NEEDLE/
+e/NEEDLEbbb/
+b1048575
+/NEEDLE/
+e/NEEDLE2
+/
+EOF
+
+echo "testing forward search beyond last match fails"
+$DODO "$TESTFILENAME" <<'EOF' && fail "search beyond last match succeeded"
+b1048575
+/NEEDLE/
+b4048581
+/NEEDLE/
+EOF
+
+echo "testing backward search across blocks"
+$DODO "$TESTFILENAME" <<'EOF' || fail "backward search"
+b4048581
+?NEEDLE?
+e/NEEDLE2/
+?NEEDLE?
+e/NEEDLEbbb/
+b1048576
+?NEEDLE?
+e/NEEDLEbbb/
+EOF
+
+echo "testing backward search before first match fails"
+$DODO "$TESTFILENAME" <<'EOF' && fail "search before first match succeeded"
+b1048574
+?NEEDLE?
+EOF
+
+echo "testing regex search across blocks"
+$DODO "$TESTFILENAME" <<'EOF' || fail "regex search"
+r/NEE[D]LE\d?/
+e/NEEDLEbbb/
+b1048575
+r/N[E]+DLE\d/
+e/NEEDLE2
+/
+b10
+r/[ab]+NEEDLE/
+w/Z/
+b9
+e/aZa/
+EOF
+
+echo "testing regex search that can never match finishes"
+$DODO "$TESTFILENAME" <<'EOF' && fail "regex search for missing byte succeeded"
+r/(a*)*(b*)*c/
+EOF
+
+# random a and b, enough for the dfa to outgrow its cache of states
+printf 'ab%.0s' $(seq 128) > "$TESTFILENAME.map"
+head -c 300000 /dev/urandom | tr '\000-\377' "$(cat "$TESTFILENAME.map")" > "$TESTFILENAME"
+printf 'abbbbbbbbbbbbX\n' >> "$TESTFILENAME"
+rm -f -- "$TESTFILENAME.map"
+
+echo "testing regex search with a dfa too big to cache"
+$DODO "$TESTFILENAME" <<'EOF' || fail "regex search with large dfa"
+r/a[ab]{12}X/
+e/abbbbbbbbbbbbX/
+EOF
+
+rm -f -- "$TESTFILENAME"
+
+echo "search testing completed successfully"
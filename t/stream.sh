@@ -0,0 +1,73 @@
+#!/usr/bin/env bash
+
+# run exhaustive tests again streaming each program through
+TESTS_DIR="t/tests/exhaustive/"
+TEST_CMD="./dodo --stream"
+
+source t/harness.sh
+
+# then stream programs spanning many reads of the program buffer
+# set DODO to run these through a different dodo command line
+
+set -eu
+
+DODO=${DODO:-./dodo}
+
+WHOLE=$(mktemp) || exit
+STREAMED=$(mktemp) || exit
+PROGRAM=$(mktemp) || exit
+
+fail() {
+    echo "stream test failed: $1"
+    echo "leaving tmp files laying around as '$WHOLE', '$STREAMED' and '$PROGRAM'"
+    exit 1
+}
+
+# every line is 7 bytes so line n starts at byte 7 * (n - 1)
+reset() {
+    seq -w 1 200000 > "$WHOLE"
+    cp "$WHOLE" "$STREAMED"
+}
+
+# patches with strings, escapes, comments and substitutions,
+# so buffers end part way through every kind of instruction
+awk 'BEGIN {
+    for( k = 0; k < 40000; ++k ){
+        n = (k * 7919) % 200000 + 1
+        printf "b%d e/%06d\n/ # line %d\nw/a\\/%03d/\n", 7 * (n - 1), n, n, k % 1000
+        if( k % 5000 == 0 ){
+            printf "s/a\\/0/b\\/1/g\nl%d\np3\n", n
+        }
+    }
+}' > "$PROGRAM"
+
+echo "testing streamed program matches whole program"
+reset
+$DODO "$WHOLE" < "$PROGRAM" > "$WHOLE.stdout" || fail "whole program"
+$DODO --stream "$STREAMED" < "$PROGRAM" > "$STREAMED.stdout" || fail "streamed program"
+cmp "$WHOLE" "$STREAMED" || fail "streamed program left file different"
+cmp "$WHOLE.stdout" "$STREAMED.stdout" || fail "streamed program printed differently"
+rm "$WHOLE.stdout" "$STREAMED.stdout"
+
+echo "testing instruction longer than program buffer"
+reset
+{ echo "b7"; printf 'w/'; head -c 999999 /dev/zero | tr '\0' 'x'; echo "/"; echo "e/142859"; echo "/"; } > "$PROGRAM"
+$DODO --stream "$STREAMED" < "$PROGRAM" || fail "long instruction"
+cmp -n 1000006 "$STREAMED" <( printf '000001\n'; head -c 999999 /dev/zero | tr '\0' 'x' ) || fail "long instruction left file wrong"
+
+echo "testing streamed program runs up to a parse error"
+reset
+$DODO --stream "$STREAMED" > /dev/null <<'EOF2' && fail "parse error succeeded"
+b0
+w/before/
+z
+w/after/
+EOF2
+$DODO "$STREAMED" <<'EOF2' || fail "write before parse error was lost"
+b0
+e/before/
+EOF2
+
+rm "$WHOLE" "$STREAMED" "$PROGRAM"
+
+echo "stream testing completed successfully"
@@ -0,0 +1,107 @@
+#!/usr/bin/env bash
+
+# run exhaustive tests again checking expects before anything is written
+TESTS_DIR="t/tests/exhaustive/"
+TEST_CMD="./dodo --verify-first"
+
+source t/harness.sh
+
+# then check a failing expect leaves the file untouched wherever it is in the program
+
+set -eu
+
+TESTFILE=$(mktemp) || exit
+PROGRAM=$(mktemp) || exit
+
+fail() {
+    echo "verify test failed: $1"
+    echo "leaving tmp files laying around as '$TESTFILE' and '$PROGRAM'"
+    exit 1
+}
+
+# every line is 7 bytes so line n starts at byte 7 * (n - 1)
+reset() {
+    seq -w 1 200000 > "$TESTFILE"
+}
+
+# patches of lines ending with an expect that fails
+awk 'BEGIN {
+    for( n = 1; n <= 200000; n += 7 ){
+        printf "b%d\ne/%06d/\nw/x%05d/\n", 7 * (n - 1), n, n % 100000
+    }
+    printf "b%d\ne/nope/\n", 7 * 3
+}' > "$PROGRAM"
+
+for opts in "" "--mmap" "--stdio" "-P" "-x"; do
+    echo "testing late failing expect with '$opts'"
+    reset
+    ./dodo -V $opts "$TESTFILE" < "$PROGRAM" > /dev/null && fail "late failing expect passed with '$opts'"
+    seq -w 1 200000 | cmp - "$TESTFILE" || fail "late failing expect with '$opts' changed file"
+    rm -f "$TESTFILE.dodoidx"
+done
+
+echo "testing expects see earlier writes"
+printf 'hello world\n' > "$TESTFILE"
+./dodo -V "$TESTFILE" <<EOF || fail "expect over earlier write"
+b6 w/marge/
+b4 e/o marge/
+b0 w/j/
+b0 e/jello/
+EOF
+printf 'jello marge\n' | cmp - "$TESTFILE" || fail "expects over earlier writes left file wrong"
+
+./dodo -V "$TESTFILE" <<EOF > /dev/null && fail "expect of overwritten bytes passed"
+b6 w/world/
+b6 e/marge/
+EOF
+printf 'jello marge\n' | cmp - "$TESTFILE" || fail "expect of overwritten bytes changed file"
+
+echo "testing expects past the end of the file"
+./dodo -V "$TESTFILE" <<EOF || fail "expect past end after extending write"
+b14 w/tail/
+b14 e/tail/
+b12 w/xx/
+b10 e/e
+xxtail/
+EOF
+printf 'jello marge\nxxtail' | cmp - "$TESTFILE" || fail "extending write left file wrong"
+
+./dodo -V "$TESTFILE" <<EOF > /dev/null && fail "expect past end passed"
+b16 e/tail!/
+b0 w/J/
+EOF
+printf 'jello marge\nxxtail' | cmp - "$TESTFILE" || fail "expect past end changed file"
+
+echo "testing expects after a search are left to run in order"
+printf 'one two three\n' > "$TESTFILE"
+./dodo -V "$TESTFILE" <<EOF || fail "expect after search"
+b0 w/ONE/
+/two/ e/two/ w/TWO/
+EOF
+printf 'ONE TWO three\n' | cmp - "$TESTFILE" || fail "expect after search left file wrong"
+
+./dodo -V "$TESTFILE" <<EOF > /dev/null && fail "expect after search passed"
+b0 w/one/
+/TWO/ e/nope/
+EOF
+printf 'one TWO three\n' | cmp - "$TESTFILE" || fail "in order run did not stop at failing expect"
+
+echo "testing an expect after an insert is left to run in order"
+./dodo -V "$TESTFILE" <<EOF || fail "expect after insert"
+b0 i/>/
+b1 e/one/
+EOF
+printf '>one TWO three\n' | cmp - "$TESTFILE" || fail "expect after insert left file wrong"
+
+echo "testing batches"
+cp "$TESTFILE" "$PROGRAM"
+printf 'b1 w/ONE/ b20 e/x/' | ./dodo -V "$TESTFILE" "$PROGRAM" > /dev/null && fail "batch with failing expect passed"
+printf '>one TWO three\n' | cmp - "$TESTFILE" || fail "batch changed first file"
+printf '>one TWO three\n' | cmp - "$PROGRAM" || fail "batch changed second file"
+
+echo "testing with interactive"
+./dodo -V -i "$TESTFILE" < /dev/null > /dev/null && fail "verify with interactive was allowed"
+
+rm "$TESTFILE" "$PROGRAM"
+
+echo "verify testing completed successfully"